@@ -0,0 +1,53 @@
+#!/usr/bin/perl -w
+use strict;
+
+#Compares two neural_bench result files (see bench/Makefile), printing the
+#change in each measurement they share, slowest first, and marking those
+#more than <threshold> percent slower (default 5).  Exits with status 1 if
+#any are.
+#
+#usage: compare.pl <old_results> <new_results> [<threshold>]
+
+unless( @ARGV == 2 or @ARGV == 3 ) {
+  print "usage: $0 <old_results> <new_results> [<threshold>]\n";
+  exit(-1);
+}
+my $threshold = defined $ARGV[2] ? $ARGV[2] : 5;
+
+my %old = read_results( $ARGV[0] );
+my %new = read_results( $ARGV[1] );
+
+my @changes;
+for my $key (sort( keys( %new ) )) {
+  next unless defined $old{$key} and $old{$key} > 0;
+  push @changes, [ $key, $old{$key}, $new{$key},
+		   ( $new{$key} - $old{$key} ) * 100 / $old{$key} ];
+}
+my $slower = 0;
+for my $c (sort { $b->[3] <=> $a->[3] } @changes) {
+  my $mark = '';
+  if( $c->[3] > $threshold ) {
+    $mark = '  SLOWER';
+    $slower++;
+  }
+  printf( "%-40s %12.1f %12.1f %+7.1f%%%s\n", @$c, $mark );
+}
+for my $key (sort( keys( %old ) )) {
+  print "$key: missing from $ARGV[1]\n" unless defined $new{$key};
+}
+exit( $slower ? 1 : 0 );
+
+#{ "<net> <measurement>" => ns/example }
+sub read_results {
+  my $fname = shift;
+  my %results;
+  open RESULTS, "<$fname" or die "Can't open $fname: $!";
+  while( <RESULTS> ) {
+    next if /^#/;
+    my( $net, $what, $ns ) = split;
+    next unless defined $ns;
+    $results{"$net $what"} = $ns;
+  }
+  close RESULTS;
+  return %results;
+}
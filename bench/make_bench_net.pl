@@ -0,0 +1,57 @@
+#!/usr/bin/perl -w
+use strict;
+
+#Writes a synthetic network for the benchmarks, in NetCompiler's human
+#readable format, with the shape given by its file name:
+#
+#  syn_<width>x<depth>[_fb<feedback>].net
+#
+#<depth> fully connected hidden layers of <width> nodes each (A, B, ...)
+#between 16 inputs and 4 outputs; the first <feedback> of them also take
+#input from every node of their own layer, making feedback groups.
+
+my $INPUTS = 16;
+my $OUTPUTS = 4;
+
+unless( @ARGV == 1 and
+	$ARGV[0] =~ /(?:^|\/)syn_(\d+)x(\d+)(?:_fb(\d+))?\.net$/ ) {
+  print "usage: $0 syn_<width>x<depth>[_fb<feedback>].net\n";
+  exit(-1);
+}
+my( $width, $depth, $feedback ) = ( $1, $2, $3 || 0 );
+die "depth must be 1 to 25\n" unless $depth >= 1 and $depth <= 25;
+die "feedback can't exceed depth\n" if $feedback > $depth;
+
+my @layers = map { chr( ord( 'A' ) + $_ ) } (0 .. $depth - 1);
+
+#a node connected to every node in the given layers
+sub node {
+  my @ins;
+  for my $layer (@_) {
+    my $count = ( $layer eq 'IN' ) ? $INPUTS : $width;
+    push @ins, map { "[\"$layer$_\", 'R']" } (1..$count);
+  }
+  return "[ " . join( ", ", @ins ) . " ]";
+}
+
+open OUT, ">$ARGV[0]" or die "Can't open $ARGV[0] for output: $!";
+print OUT "{ OPTIONS => { INPUTS => $INPUTS,\n";
+print OUT "               OUTPUTS => $OUTPUTS },\n";
+print OUT "  LAYERS => {\n";
+my $prev = 'IN';
+for my $i (0 .. $#layers) {
+  my @from = ( $prev );
+  push @from, $layers[$i] if $i < $feedback;
+  my $node = node( @from );
+  print OUT "    $layers[$i] => [\n";
+  print OUT "      $node,\n" for (1..$width);
+  print OUT "    ],\n";
+  $prev = $layers[$i];
+}
+my $node = node( $prev );
+print OUT "    OUT => [\n";
+print OUT "      $node,\n" for (1..$OUTPUTS);
+print OUT "    ],\n";
+print OUT "  }\n}\n";
+close OUT;
+exit(0);
@@ -4,7 +4,9 @@ use strict;
 
 use NetCompiler;
 
-my $fname = $ARGV[0];
-my $out = $ARGV[1];
+#compile.pl <net> <out.c> [precision=float] [activation=fast] [fold=1] [dense=<n>]
+my $fname = shift @ARGV;
+my $out = shift @ARGV;
+my %opts = map { split /=/, $_, 2 } @ARGV;
 my $nc = NetCompiler->new( filename => $fname );
-$nc->compile( 'c', filename => "$out" );
+$nc->compile( 'c', filename => "$out", %opts );
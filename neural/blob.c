@@ -0,0 +1,457 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_telemetry.h"
+#include "neural_blob.h"
+
+/* These follow network.c.tmpl step for step (including the order in which
+   sums are accumulated), so a blob computes exactly what the compiled
+   net does. */
+
+static double sigmoid( double sum ) {
+  return 2 / ( 1 + exp( -sum ) ) - 1;
+}
+
+//derivative of sigmoid fn:
+static double Dsigmoid( double sigmoid ) {
+  return 0.5 * ( 1 - sigmoid * sigmoid );
+}
+
+int is_net_blob( const char *net_file ) {
+  FILE *file;
+  char magic[4];
+  int is_blob = 0;
+
+  file = fopen( net_file, "r" );
+  if( file == NULL ) {
+    return 0;
+  }
+  if( 1 == fread( magic, sizeof( magic ), 1, file ) &&
+      0 == memcmp( magic, NET_BLOB_MAGIC, sizeof( magic ) ) ) {
+    is_blob = 1;
+  }
+  fclose( file );
+  return is_blob;
+}
+
+static int range_ok( int start, int end, int count ) {
+  return 0 <= start && start <= end && end <= count;
+}
+
+//checks that every index in the blob is in range, so a corrupt file
+//can't send the interpreter outside its arrays
+static int check_blob( net_blob *b ) {
+  net_blob_header *h = &b->head;
+  int i;
+
+  for( i = 0; i < h->input_count; i++ ) {
+    if( !range_ok( b->inputs[i], b->inputs[i], h->node_count - 1 ) ) {
+      return -1;
+    }
+  }
+  for( i = 0; i < h->output_count; i++ ) {
+    if( !range_ok( b->outputs[i], b->outputs[i], h->node_count - 1 ) ) {
+      return -1;
+    }
+  }
+  for( i = 0; i < h->set_count; i++ ) {
+    if( !range_ok( b->sets[i].first_node, b->sets[i].end_node,
+		   h->node_entry_count ) ) {
+      return -1;
+    }
+  }
+  for( i = 0; i < h->node_entry_count; i++ ) {
+    if( !range_ok( b->nodes[i].node, b->nodes[i].node, h->node_count - 1 ) ||
+	!range_ok( b->nodes[i].in_start, b->nodes[i].in_end, h->in_count ) ||
+	!range_ok( b->nodes[i].out_start, b->nodes[i].out_end,
+		   h->out_count ) ) {
+      return -1;
+    }
+  }
+  for( i = 0; i < h->in_count; i++ ) {
+    if( !range_ok( b->ins[i].node, b->ins[i].node, h->node_count - 1 ) ||
+	!range_ok( b->ins[i].weight, b->ins[i].weight, h->weight_count - 1 ) ) {
+      return -1;
+    }
+  }
+  for( i = 0; i < h->out_count; i++ ) {
+    if( !range_ok( b->outs[i].node, b->outs[i].node, h->node_count - 1 ) ||
+	!range_ok( b->outs[i].weight, b->outs[i].weight,
+		   h->weight_count - 1 ) ) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int load_blob_net( const char *net_file, net_definition *def ) {
+  char *fn = "load_blob_net";
+  FILE *file;
+  net_blob *b;
+  net_blob_header *h;
+  long size, expected;
+  char *p;
+  int i;
+
+  file = fopen( net_file, "r" );
+  if( file == NULL ) {
+    sprintf_neural_err( "%s: can't open %s: %s", fn, net_file,
+			strerror( errno ) );
+    return -1;
+  }
+  if( 0 > fseek( file, 0, SEEK_END ) || 0 > (size = ftell( file )) ) {
+    fclose( file );
+    ERRNO_OUT( fn, "can't find blob size" );
+  }
+  rewind( file );
+  if( size < sizeof( net_blob_header ) ) {
+    fclose( file );
+    ERR_OUT( fn, "blob is truncated" );
+  }
+  b = (net_blob *)neural_calloc( 1, sizeof( net_blob ) );
+  if( b == NULL || NULL == (b->data = neural_malloc( size )) ) {
+    free( b );
+    fclose( file );
+    ERRNO_OUT( fn, "can't allocate blob" );
+  }
+  if( 1 != fread( b->data, size, 1, file ) ) {
+    fclose( file );
+    free_net_blob( b );
+    ERR_OUT( fn, "blob is truncated" );
+  }
+  fclose( file );
+
+  memcpy( &b->head, b->data, sizeof( net_blob_header ) );
+  h = &b->head;
+  if( h->version != NET_BLOB_VERSION ) {
+    free_net_blob( b );
+    ERR_OUT( fn, "unknown blob version" );
+  }
+  if( h->input_count < 0 || h->output_count < 0 || h->weight_count < 0 ||
+      h->node_count < 0 || h->set_count < 0 || h->node_entry_count < 0 ||
+      h->in_count < 0 || h->out_count < 0 ) {
+    free_net_blob( b );
+    ERR_OUT( fn, "blob header is corrupt" );
+  }
+  expected = sizeof( net_blob_header ) +
+    sizeof( double ) * (long)h->in_count +
+    sizeof( int ) * ( (long)h->input_count + h->output_count ) +
+    sizeof( blob_set ) * (long)h->set_count +
+    sizeof( blob_node ) * (long)h->node_entry_count +
+    sizeof( blob_link ) * ( (long)h->in_count + h->out_count );
+  if( size != expected ) {
+    free_net_blob( b );
+    ERR_OUT( fn, "blob size doesn't match its header" );
+  }
+
+  p = (char *)b->data + sizeof( net_blob_header );
+  b->fixed_weights = (double *)p;
+  p += sizeof( double ) * h->in_count;
+  b->inputs = (int *)p;
+  p += sizeof( int ) * h->input_count;
+  b->outputs = (int *)p;
+  p += sizeof( int ) * h->output_count;
+  b->sets = (blob_set *)p;
+  p += sizeof( blob_set ) * h->set_count;
+  b->nodes = (blob_node *)p;
+  p += sizeof( blob_node ) * h->node_entry_count;
+  b->ins = (blob_link *)p;
+  p += sizeof( blob_link ) * h->in_count;
+  b->outs = (blob_link *)p;
+  if( 0 > check_blob( b ) ) {
+    free_net_blob( b );
+    ERR_OUT( fn, "blob has an index out of range" );
+  }
+
+  for( i = 0; i < h->set_count; i++ ) {
+    if( b->sets[i].flags & BLOB_SET_FEEDBACK ) {
+      b->feedback_groups++;
+    }
+  }
+
+  memset( (void *)def, 0, sizeof( net_definition ) );
+  def->blob = b;
+  def->info.input_count = h->input_count;
+  def->info.output_count = h->output_count;
+  def->info.weight_count = h->weight_count;
+  def->info.node_count = h->node_count;
+  def->info.feedback_groups = b->feedback_groups;
+  //as the compiled net's _net_info works it out
+  def->info.feedback_limit = h->feedback_limit;
+  def->info.feedback_convergence = h->feedback_convergence_ppm / 1e6;
+  net_feedback_settings( def );
+  return 0;
+}
+
+void free_net_blob( net_blob *blob ) {
+  if( blob ) {
+    free( blob->data );
+    free( blob );
+  }
+}
+
+int blob_calc_net( net_blob *b,
+		   int *inputs, int input_count,
+		   int *outputs, int output_count,
+		   double *weights, int weight_count,
+		   double *node_values, int node_count,
+		   int feedback_limit, double feedback_convergence,
+		   net_feedback *feedback ) {
+  net_blob_header *h = &b->head;
+  double node[h->node_count + 1], presum[h->node_count + 1];
+  double old_value, sum;
+  int feedback_changes, group = 0;
+  int warm = feedback != NULL && node_values != NULL &&
+    ( feedback->flags & NET_FEEDBACK_WARM_START );
+  int i, j, s;
+  blob_node *n;
+  blob_link *in;
+
+  if( input_count != h->input_count || output_count != h->output_count ||
+      weight_count != h->weight_count ) {
+    return -1;
+  }
+  if( node_values != NULL && node_count != h->node_count ) {
+    return -1;
+  }
+  for( i = 0; i < h->node_count; i++ ) {
+    node[i] = presum[i] = 0;
+  }
+
+  //load input values into input nodes
+  for( i = 0; i < h->input_count; i++ ) {
+    node[b->inputs[i]] = inputs[i];
+  }
+
+  for( s = 0; s < h->set_count; s++ ) {
+    blob_node *first = b->nodes + b->sets[s].first_node;
+    blob_node *end = b->nodes + b->sets[s].end_node;
+    if( b->sets[s].flags & BLOB_SET_FEEDBACK ) {
+      //pre-calculate external inputs for all nodes, before feedback loop:
+      for( n = first; n < end; n++ ) {
+	sum = 0;
+	for( in = b->ins + n->in_start; in < b->ins + n->in_end; in++ ) {
+	  if( !(in->flags & BLOB_LINK_FB_GROUP) ) {
+	    sum = sum + node[in->node] * weights[in->weight];
+	  }
+	}
+	presum[n->node] = sum;
+      }
+      if( warm ) {
+	for( n = first; n < end; n++ ) {
+	  node[n->node] = node_values[n->node];
+	}
+      }
+      for( i = 0; i < feedback_limit; i++ ) {
+	feedback_changes = 0;
+	for( n = first; n < end; n++ ) {
+	  old_value = node[n->node];
+	  sum = presum[n->node];
+	  for( in = b->ins + n->in_start; in < b->ins + n->in_end; in++ ) {
+	    if( in->flags & BLOB_LINK_FB_GROUP ) {
+	      sum = sum + node[in->node] * weights[in->weight];
+	    }
+	  }
+	  node[n->node] = sigmoid( sum + 0 );
+	  if( fabs( node[n->node] - old_value ) > feedback_convergence ) {
+	    feedback_changes++;
+	  }
+	}
+	if( !feedback_changes ) {
+	  break;
+	}
+      }
+      if( feedback != NULL ) {
+	feedback->stats.sweeps[NET_FEEDBACK_STAT( group )] +=
+	  ( i < feedback_limit ) ? i + 1 : i;
+	if( i == feedback_limit ) {
+	  feedback->stats.unsettled++;
+	}
+      }
+      group++;
+    } else {
+      for( n = first; n < end; n++ ) {
+	if( n->in_start == n->in_end ) {
+	  continue;
+	}
+	in = b->ins + n->in_start;
+	sum = node[in->node] * weights[in->weight];
+	for( in++; in < b->ins + n->in_end; in++ ) {
+	  sum = sum + node[in->node] * weights[in->weight];
+	}
+	node[n->node] = sigmoid( sum );
+      }
+    }
+  }
+
+  //convert from continuous values back to +1/-1
+  for( i = 0; i < h->output_count; i++ ) {
+    outputs[i] = ( (node[b->outputs[i]] > 0) ? 1 : -1 );
+  }
+  if( node_values != NULL ) {
+    for( j = 0; j < h->node_count; j++ ) {
+      node_values[j] = node[j];
+    }
+  }
+  return 0;
+}
+
+int blob_setup_weights( net_blob *b, double *weights, int weight_count,
+			unsigned int *seed, int make_seed ) {
+  unsigned int my_seed;
+  int i;
+
+  if( weight_count != b->head.weight_count ) {
+    return -1;
+  }
+  //same seed handling as _setup_initial_weights in network.c.tmpl
+  if( make_seed || seed == NULL ) {
+    my_seed = neural_seed();
+    if( seed != NULL ) {
+      *seed = my_seed;
+      seed = NULL;
+    }
+  } else {
+    my_seed = *seed;
+  }
+
+  //the ins are stored in the order the template visits them
+  for( i = 0; i < b->head.in_count; i++ ) {
+    if( b->ins[i].flags & BLOB_LINK_RANDOM ) {
+      weights[b->ins[i].weight] = (double)rand_r( &my_seed )/(double)(RAND_MAX/2);
+    } else {
+      weights[b->ins[i].weight] = b->fixed_weights[i];
+    }
+  }
+  if( seed != NULL ) {
+    *seed = my_seed;
+  }
+  return 0;
+}
+
+void blob_train_net( net_blob *b, double *weights,
+		     double *weight_changes, int weight_count,
+		     double *node_values, int node_count,
+		     int *correct_outputs, int output_count,
+		     int feedback_limit, double feedback_convergence,
+		     double training_level, net_feedback *feedback ) {
+  net_blob_header *h = &b->head;
+  double err[h->node_count + 1], presum_err[h->node_count + 1];
+  double *node = node_values;
+  double old_err, sum;
+  int training_sign = (training_level > 0) ? 1 : -1;
+  int feedback_changes, group = b->feedback_groups;
+  int warm = feedback != NULL &&
+    ( feedback->flags & NET_FEEDBACK_WARM_START );
+  int i, o, s;
+  blob_node *n;
+  blob_link *in, *out;
+
+  for( i = 0; i < h->node_count; i++ ) {
+    err[i] = presum_err[i] = 0;
+  }
+  for( i = 0; i < weight_count; i++ ) {
+    weight_changes[i] = 0;
+  }
+
+  for( i = 0; i < h->output_count; i++ ) {
+    o = b->outputs[i];
+    if( correct_outputs != NULL ) {
+      err[o] = Dsigmoid( node[o] ) * ( correct_outputs[i] - node[o] );
+    } else {
+      err[o] = Dsigmoid( node[o] ) *
+	( training_sign * ((node[o] > 0)? 1 : -1) - node[o] );
+    }
+  }
+  if( correct_outputs == NULL ) {
+    training_level = fabs( training_level );
+  }
+
+  //work backwards through net to compute error for each node.
+  for( s = h->set_count - 1; s >= 0; s-- ) {
+    blob_node *first = b->nodes + b->sets[s].first_node;
+    blob_node *end = b->nodes + b->sets[s].end_node;
+    if( b->sets[s].flags & BLOB_SET_FEEDBACK ) {
+      for( n = first; n < end; n++ ) {
+	sum = 0;
+	for( out = b->outs + n->out_start; out < b->outs + n->out_end; out++ ) {
+	  if( !(out->flags & BLOB_LINK_FB_GROUP) ) {
+	    sum = sum + err[out->node] * weights[out->weight];
+	  }
+	}
+	presum_err[n->node] = sum;
+      }
+      if( warm ) {
+	for( n = first; n < end; n++ ) {
+	  if( !( n->flags & BLOB_NODE_OUTPUT ) ) {
+	    err[n->node] = feedback->errors[n->node];
+	  }
+	}
+      }
+      for( i = 0; i < feedback_limit; i++ ) {
+	feedback_changes = 0;
+	for( n = first; n < end; n++ ) {
+	  if( n->flags & BLOB_NODE_OUTPUT ) {
+	    continue;
+	  }
+	  old_err = err[n->node];
+	  sum = presum_err[n->node];
+	  for( out = b->outs + n->out_start; out < b->outs + n->out_end;
+	       out++ ) {
+	    if( out->flags & BLOB_LINK_FB_GROUP ) {
+	      sum = sum + err[out->node] * weights[out->weight];
+	    }
+	  }
+	  err[n->node] = Dsigmoid( node[n->node] ) * ( sum + 0 );
+	  if( fabs( err[n->node] - old_err ) > feedback_convergence ) {
+	    feedback_changes++;
+	  }
+	}
+	if( !feedback_changes ) {
+	  break;
+	}
+      }
+      group--;
+      if( feedback != NULL ) {
+	feedback->stats.error_sweeps[NET_FEEDBACK_STAT( group )] +=
+	  ( i < feedback_limit ) ? i + 1 : i;
+	if( i == feedback_limit ) {
+	  feedback->stats.unsettled++;
+	}
+	//kept for the next warm start
+	for( n = first; n < end; n++ ) {
+	  feedback->errors[n->node] = err[n->node];
+	}
+      }
+    } else {
+      for( n = first; n < end; n++ ) {
+	if( n->flags & BLOB_NODE_OUTPUT ) {
+	  continue;
+	}
+	sum = 0;
+	for( out = b->outs + n->out_start; out < b->outs + n->out_end; out++ ) {
+	  sum = sum + err[out->node] * weights[out->weight];
+	}
+	err[n->node] = Dsigmoid( node[n->node] ) * sum;
+      }
+    }
+  }
+
+  //errors are computed, now calc weight changes:
+  for( s = h->set_count - 1; s >= 0; s-- ) {
+    for( n = b->nodes + b->sets[s].first_node;
+	 n < b->nodes + b->sets[s].end_node; n++ ) {
+      for( in = b->ins + n->in_start; in < b->ins + n->in_end; in++ ) {
+	weight_changes[in->weight] =
+	  training_level * err[n->node] * node[in->node];
+      }
+    }
+  }
+}
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_telemetry.h"
+#include "neural_context.h"
+
+unsigned int neural_seed() {
+  struct timeval tv;
+  gettimeofday( &tv, (struct timezone *)NULL );
+  return tv.tv_sec + tv.tv_usec + getpid();
+}
+
+int init_neural_context( neural_context *ctx, unsigned int seed ) {
+  memset( (void *)ctx, 0, sizeof( neural_context ) );
+  ctx->rng_state = seed;
+  return 0;
+}
+
+void free_neural_context( neural_context *ctx ) {
+  free_net_io( &ctx->state );
+  free_net_weights( &ctx->weight_changes );
+  free_net_weights( &ctx->batch_changes );
+  free_net_optimizer( &ctx->optimizer );
+  free( ctx->order );
+  free( ctx->batch_inputs );
+  free( ctx->batch_outputs );
+  ctx->batch_inputs = ctx->batch_outputs = NULL;
+  ctx->batch_size = 0;
+  memset( (void *)&ctx->state, 0, sizeof( net_io ) );
+  memset( (void *)&ctx->weight_changes, 0, sizeof( net_weights ) );
+  memset( (void *)&ctx->batch_changes, 0, sizeof( net_weights ) );
+  ctx->order = NULL;
+  ctx->order_count = 0;
+}
+
+double training_work( net_definition *def, training_statistics *stats ) {
+  return (double)def->info.weight_count *
+    ( (double)stats->presentation_count + 2.0 * stats->training_count +
+      stats->update_count );
+}
+
+int within_budget( neural_context *ctx, net_definition *def,
+		   training_statistics *stats ) {
+  if( ctx->presentation_budget > 0 &&
+      stats->presentation_count >= ctx->presentation_budget ) {
+    return 0;
+  }
+  if( ctx->work_budget > 0 &&
+      training_work( def, stats ) >= ctx->work_budget ) {
+    return 0;
+  }
+  return 1;
+}
+
+void shuffle_order( neural_context *ctx, int *order, int n ) {
+  int i, j, tmp;
+
+  //Fisher-Yates, drawing from (and advancing) ctx's RNG
+  for( i = n - 1; i > 0; i-- ) {
+    j = rand_r( &ctx->rng_state ) % ( i + 1 );
+    tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+}
+
+char *neural_context_error( neural_context *ctx ) {
+  return ctx->errstr;
+}
+
+void context_error( neural_context *ctx ) {
+  strncpy( ctx->errstr, neural_error(), NEURAL_ERRSTR_LEN - 1 );
+  ctx->errstr[NEURAL_ERRSTR_LEN - 1] = '\0';
+}
+
+int context_scratch( neural_context *ctx, net_definition *def, int set_count ) {
+  char *fn = "context_scratch";
+
+  if( ctx->state.input_count != def->info.input_count ||
+      ctx->state.output_count != def->info.output_count ||
+      ctx->state.node_count != def->info.node_count ) {
+    free_net_io( &ctx->state );
+    memset( (void *)&ctx->state, 0, sizeof( net_io ) );
+    if( 0 > init_net_io( def, &ctx->state, 1 ) ||
+	0 > init_net_feedback( def, &ctx->state, 0 ) ) {
+      return -1;
+    }
+  }
+  if( ctx->weight_changes.weight_count != def->info.weight_count ) {
+    free_net_weights( &ctx->weight_changes );
+    memset( (void *)&ctx->weight_changes, 0, sizeof( net_weights ) );
+    if( 0 > init_net_weights( def, &ctx->weight_changes ) ) {
+      return -1;
+    }
+  }
+  if( ctx->batch_changes.weight_count != def->info.weight_count ) {
+    free_net_weights( &ctx->batch_changes );
+    memset( (void *)&ctx->batch_changes, 0, sizeof( net_weights ) );
+    if( 0 > init_net_weights( def, &ctx->batch_changes ) ) {
+      return -1;
+    }
+  }
+  if( ctx->order_count < set_count ) {
+    free( ctx->order );
+    ctx->order_count = 0;
+    ctx->order = (int *)neural_malloc( sizeof(int) * set_count );
+    if( !ctx->order ) {
+      ERRNO_OUT( fn, "Can't allocate order array" );
+    }
+    ctx->order_count = set_count;
+  }
+  return 0;
+}
+
+int context_optimizer( neural_context *ctx, net_definition *def, int flags,
+		       double training_level, int set_count ) {
+  net_optimizer *opt = &ctx->optimizer;
+  int kind = TRAIN_OPTIMIZER_KIND( flags );
+  char *fn = "context_optimizer";
+
+  if( kind == NET_OPTIMIZER_RPROP &&
+      ( flags >> TRAIN_BATCH_SHIFT ) < set_count ) {
+    ERR_OUT( fn, "rprop needs the whole set in one batch" );
+  }
+  if( opt->kind == kind && opt->training_level == training_level &&
+      ( kind == NET_OPTIMIZER_NONE ||
+	opt->weight_count == def->info.weight_count ) ) {
+    reset_net_optimizer( opt );
+    return 0;
+  }
+  free_net_optimizer( opt );
+  return init_net_optimizer( def, opt, kind, training_level );
+}
+
+int context_batch( neural_context *ctx, net_definition *def ) {
+  char *fn = "context_batch";
+  int size = NEURAL_BATCH_SIZE * ( def->info.input_count > def->info.output_count ?
+				   def->info.input_count : def->info.output_count );
+
+  if( ctx->batch_size < size ) {
+    free( ctx->batch_inputs );
+    free( ctx->batch_outputs );
+    ctx->batch_size = 0;
+    ctx->batch_inputs = (int *)neural_malloc( sizeof(int) * size );
+    ctx->batch_outputs = (int *)neural_malloc( sizeof(int) * size );
+    if( !ctx->batch_inputs || !ctx->batch_outputs ) {
+      ERRNO_OUT( fn, "Can't allocate batch arrays" );
+    }
+    ctx->batch_size = size;
+  }
+  return 0;
+}
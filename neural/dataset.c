@@ -0,0 +1,184 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_file.h"
+#include "neural_dataset.h"
+
+int is_binary_set( const char *fname ) {
+  return file_has_magic( fname, NET_SET_MAGIC );
+}
+
+//the examples come straight out of the mapped file: each bit becomes a
+//+1/-1 in the set's arena, with no parsing
+void unpack_rows( net_io_set *set, const unsigned char *rows,
+		  int row_bytes ) {
+  int i, k;
+  int width = set->count ? set->items[0].input_count + set->items[0].output_count : 0;
+  int *dest;
+
+  for( i = 0; i < set->count; i++ ) {
+    //inputs and outputs are adjacent in the arena (see init_io_set())
+    dest = set->items[i].inputs;
+    for( k = 0; k < width; k++ ) {
+      dest[k] = ( ( rows[k >> 3] >> ( k & 7 ) ) & 1 ) * 2 - 1;
+    }
+    rows += row_bytes;
+  }
+}
+
+int load_binary_sets( const char *fname, net_io_set *sets, int first,
+		      int set_count, net_definition *def,
+		      int with_internal_state ) {
+  int i;
+  void *map;
+  size_t size, need;
+  const net_set_header *h;
+  const int *counts;
+  const unsigned char *rows;
+  char *fn = "load_binary_sets";
+
+  memset( (void *)sets, 0, sizeof( net_io_set ) * set_count );
+  if( 0 > map_file( fn, fname, &map, &size ) ) {
+    return -1;
+  }
+  h = (const net_set_header *)map;
+  counts = (const int *)( h + 1 );
+  need = sizeof( net_set_header );
+  if( size < need ||
+      memcmp( h->magic, NET_SET_MAGIC, sizeof( h->magic ) ) ||
+      h->version != NET_SET_VERSION ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "not a version 1 set file" );
+  }
+  if( h->input_count != def->info.input_count ||
+      h->output_count != def->info.output_count ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "input/output counts don't match file" );
+  }
+  if( h->set_count < first + set_count || h->set_count < 0 ||
+      h->row_bytes != ( h->input_count + h->output_count + 7 ) / 8 ||
+      size < need + sizeof( int ) * h->set_count ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "set file header is inconsistent" );
+  }
+  need += sizeof( int ) * h->set_count;
+  for( i = 0; i < h->set_count; i++ ) {
+    if( counts[i] < 0 ) {
+      unmap_file( map, size );
+      ERR_OUT( fn, "set file header is inconsistent" );
+    }
+    need += (size_t)counts[i] * h->row_bytes;
+  }
+  if( size != need ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "set file is truncated" );
+  }
+  if( file_checksum( h + 1, need - sizeof( net_set_header ) ) != h->checksum ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "set file checksum mismatch" );
+  }
+
+  rows = (const unsigned char *)( counts + h->set_count );
+  for( i = 0; i < first; i++ ) {
+    rows += (size_t)counts[i] * h->row_bytes;
+  }
+  for( i = 0; i < set_count; i++ ) {
+    if( 0 > init_io_set( sets + i, counts[first + i], def,
+			 with_internal_state ) ) {
+      //error already set
+      while( i-- > 0 ) {
+	free_io_set( sets + i );
+      }
+      unmap_file( map, size );
+      return -1;
+    }
+    unpack_rows( sets + i, rows, h->row_bytes );
+    rows += (size_t)counts[first + i] * h->row_bytes;
+  }
+  unmap_file( map, size );
+  return 0;
+}
+
+int load_io_sets( const char *fname, net_io_set *sets, int set_count,
+		  net_definition *def, int with_internal_state ) {
+  FILE *file;
+  int i;
+  char *fn = "load_io_sets";
+
+  if( is_binary_set( fname ) ) {
+    return load_binary_sets( fname, sets, 0, set_count, def,
+			     with_internal_state );
+  }
+  file = fopen( fname, "r" );
+  if( file == NULL ) {
+    sprintf_neural_err( "%s: can't open %s: %s", fn, fname, strerror( errno ) );
+    return -1;
+  }
+  for( i = 0; i < set_count; i++ ) {
+    if( 0 > fread_io_set( file, sets + i, def, with_internal_state ) ) {
+      //error already set by fread_io_set()
+      while( i-- > 0 ) {
+	free_io_set( sets + i );
+      }
+      fclose( file );
+      return -1;
+    }
+  }
+  fclose( file );
+  return 0;
+}
+
+int skip_io_set( FILE *file, net_definition *def ) {
+  net_io_set one;
+  int count, i;
+  char *fn = "skip_io_set";
+
+  if( 1 != fscanf( file, "%d", &count ) || count < 0 ) {
+    ERR_OUT( fn, "can't read set count" );
+  }
+  //one example's worth of space, read over and over
+  if( 0 > init_io_set( &one, 1, def, 0 ) ) {
+    return -1;
+  }
+  for( i = 0; i < count; i++ ) {
+    if( 0 > fread_net_io( file, one.items ) ) {
+      free_io_set( &one );
+      return -1;
+    }
+  }
+  free_io_set( &one );
+  return 0;
+}
+
+int load_io_set( const char *fname, int which, net_io_set *set,
+		 net_definition *def, int with_internal_state ) {
+  FILE *file;
+  int i;
+  char *fn = "load_io_set";
+
+  if( is_binary_set( fname ) ) {
+    return load_binary_sets( fname, set, which, 1, def,
+			     with_internal_state );
+  }
+  file = fopen( fname, "r" );
+  if( file == NULL ) {
+    sprintf_neural_err( "%s: can't open %s: %s", fn, fname, strerror( errno ) );
+    return -1;
+  }
+  for( i = 0; i < which; i++ ) {
+    if( 0 > skip_io_set( file, def ) ) {
+      fclose( file );
+      return -1;
+    }
+  }
+  if( 0 > fread_io_set( file, set, def, with_internal_state ) ) {
+    fclose( file );
+    return -1;
+  }
+  fclose( file );
+  return 0;
+}
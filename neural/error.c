@@ -4,16 +4,16 @@
 #include "neural.h"
 #include "neural_err.h"
 
-char neural_errstr[1024];
+static __thread char neural_errstr[NEURAL_ERRSTR_LEN];
 
 void set_neural_error( char *description ) {
-  strncpy( neural_errstr, description, 1024 );
+  strncpy( neural_errstr, description, NEURAL_ERRSTR_LEN - 1 );
 }
 
 void sprintf_neural_err( char *format, ... ) {
   va_list args;
   va_start( args, format );
-  vsnprintf( neural_errstr, 1024, format, args );
+  vsnprintf( neural_errstr, NEURAL_ERRSTR_LEN, format, args );
   va_end( args );
 }
 
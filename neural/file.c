@@ -0,0 +1,70 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_file.h"
+
+int map_file( const char *fn, const char *fname, void **map, size_t *size ) {
+  int fd;
+  struct stat st;
+
+  fd = open( fname, O_RDONLY );
+  if( fd < 0 ) {
+    sprintf_neural_err( "%s: can't open %s: %s", fn, fname, strerror( errno ) );
+    return -1;
+  }
+  if( 0 > fstat( fd, &st ) ) {
+    close( fd );
+    ERRNO_OUT( fn, "can't stat file" );
+  }
+  if( st.st_size == 0 ) {
+    close( fd );
+    ERR_OUT( fn, "file is empty" );
+  }
+  *map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if( *map == MAP_FAILED ) {
+    ERRNO_OUT( fn, "can't map file" );
+  }
+  *size = st.st_size;
+  return 0;
+}
+
+void unmap_file( void *map, size_t size ) {
+  munmap( map, size );
+}
+
+unsigned int file_checksum( const void *data, size_t len ) {
+  const unsigned char *p = (const unsigned char *)data;
+  unsigned int hash = 2166136261u;
+  size_t i;
+
+  for( i = 0; i < len; i++ ) {
+    hash = ( hash ^ p[i] ) * 16777619u;
+  }
+  return hash;
+}
+
+int file_has_magic( const char *fname, const char *magic ) {
+  FILE *file;
+  char buf[4];
+  int has_magic = 0;
+
+  file = fopen( fname, "r" );
+  if( file == NULL ) {
+    return 0;
+  }
+  if( 1 == fread( buf, sizeof( buf ), 1, file ) &&
+      0 == memcmp( buf, magic, sizeof( buf ) ) ) {
+    has_magic = 1;
+  }
+  fclose( file );
+  return has_magic;
+}
@@ -9,8 +9,50 @@ struct net_info {
   int weight_count;
   int output_count;
   int node_count;
+  int variant; //NET_VARIANT_* bits: how the net was compiled
+  int feedback_groups;
+  //the net's own settings; 0 (as from older nets) for the defaults below
+  int feedback_limit;
+  double feedback_convergence;
 };
 
+#define NET_DEFAULT_FEEDBACK_LIMIT 1000
+#define NET_DEFAULT_FEEDBACK_CONVERGENCE 0.05
+//a net's own settings are kept to at most the default limit, and below
+//a convergence of 1
+#define NET_MAX_FEEDBACK_CONVERGENCE 0.999999
+
+//the net computes in float rather than double
+#define NET_VARIANT_FLOAT 1
+//the net's sigmoid is a rational approximation rather than exp() based
+#define NET_VARIANT_FAST_SIGMOID 2
+
+/* Per-net_io state for the relaxation of feedback groups, which runs
+   sweeps over a group's nodes until none moves more than the net's
+   feedback_convergence (or feedback_limit sweeps pass), forward for the
+   node values and backward for the error terms.  With
+   NET_FEEDBACK_WARM_START a group starts from the io's current node_values
+   and the errors left by its last training pass, rather than from 0, which
+   saves sweeps when consecutive examples settle to similar states.  The
+   sweeps are counted per group (groups past the last slot share it). */
+#define NET_FEEDBACK_WARM_START 1
+#define NET_FEEDBACK_STATS 8
+#define NET_FEEDBACK_STAT( group ) \
+  ( (group) < NET_FEEDBACK_STATS ? (group) : NET_FEEDBACK_STATS - 1 )
+
+typedef struct _net_feedback_stats_STRUCT {
+  long sweeps[NET_FEEDBACK_STATS];
+  long error_sweeps[NET_FEEDBACK_STATS];
+  long unsettled; //relaxations stopped by feedback_limit
+} net_feedback_stats;
+
+typedef struct _net_feedback_STRUCT {
+  int flags;
+  double *errors; //node_count error terms, for warm starts
+  int node_count;
+  net_feedback_stats stats;
+} net_feedback;
+
 typedef int (*calc_network_fn)( int *inputs, int input_count,
 				int *outputs, int output_count,
 				double *weights, int weight_count,
@@ -24,15 +66,55 @@ typedef void (*train_net_fn)( double *weights,
 			      int *correct_outputs, int output_count,
 			      int feedback_limit, double feedback_convergence,
 			      double training_level );
+typedef int (*calc_network_fb_fn)( int *inputs, int input_count,
+				   int *outputs, int output_count,
+				   double *weights, int weight_count,
+				   double *node_values, int node_count,
+				   int feedback_limit,
+				   double feedback_convergence,
+				   net_feedback *feedback );
+typedef void (*train_net_fb_fn)( double *weights,
+				 double *weight_changes, int weight_count,
+				 double *node_values, int node_count,
+				 int *correct_outputs, int output_count,
+				 int feedback_limit, double feedback_convergence,
+				 double training_level,
+				 net_feedback *feedback );
 typedef void (*net_info_fn)( struct net_info *info );
+typedef int (*calc_network_batch_fn)( int *inputs, int input_count,
+				      int *outputs, int output_count,
+				      double *weights, int weight_count,
+				      int example_count,
+				      int feedback_limit,
+				      double feedback_convergence );
+//replicas per _train_replicas call (see net_replicas)
+#define NET_REPLICA_LANES 8
+typedef int (*train_replicas_fn)( int *inputs, int input_count,
+				  int *correct_outputs, int output_count,
+				  double *weights, int weight_count,
+				  int active_replicas, int train_on_success,
+				  int feedback_limit,
+				  double feedback_convergence,
+				  double training_level );
+
+struct _net_blob_STRUCT;
 
 typedef struct _net_def_STRUCT {
   calc_network_fn calculate;
   setup_initial_weights_fn setup_weights;
   train_net_fn train;
   net_info_fn get_info;
+  //NULL for nets compiled before _calc_net_batch existed
+  calc_network_batch_fn calculate_batch;
+  //NULL for nets compiled before feedback telemetry existed
+  calc_network_fb_fn calculate_fb;
+  train_net_fb_fn train_fb;
+  //NULL for nets compiled before _train_replicas existed
+  train_replicas_fn train_replicas;
   struct net_info info;
   void *dlref;
+  //set instead of the functions above for a net loaded from a blob
+  struct _net_blob_STRUCT *blob;
   int feedback_limit;
   double feedback_convergence;
 } net_definition;
@@ -44,22 +126,113 @@ typedef struct _net_io_STRUCT {
   int output_count;
   double *node_values;
   int node_count;
+  net_feedback *feedback; //NULL unless init_net_feedback() was called
 } net_io;
 
+//a whole set of examples in one allocation; see fread_io_set()
+typedef struct _net_io_set_STRUCT {
+  net_io *items;
+  net_io **ptrs;
+  int count;
+  int *arena;
+  double *node_arena;
+} net_io_set;
+
 typedef struct _net_weights_STRUCT {
   double *weights;
   int weight_count;
 } net_weights;
 
+/* Optimizers turn the weight changes of each update (training_level times
+   the error gradient, summed over a mini-batch) into the steps actually
+   taken, keeping some state per weight alongside net_weights:
+     NET_OPTIMIZER_MOMENTUM  steps by a velocity, momentum times the last
+			     one plus the changes
+     NET_OPTIMIZER_RPROP     steps each weight by its own step size (from
+			     training_level), grown while the changes keep
+			     their sign and shrunk when it flips (iRprop-);
+			     it fails to settle on per-example changes, so
+			     training rejects it without a TRAIN_BATCH of
+			     the whole set
+     NET_OPTIMIZER_ADAPTIVE  scales each weight's changes by the inverse root
+			     of their running mean square (RMSprop)
+   NET_OPTIMIZER_NONE applies the changes as they are. */
+#define NET_OPTIMIZER_NONE 0
+#define NET_OPTIMIZER_MOMENTUM 1
+#define NET_OPTIMIZER_RPROP 2
+#define NET_OPTIMIZER_ADAPTIVE 3
+#define NET_OPTIMIZER_COUNT 4
+
+typedef struct _net_optimizer_STRUCT {
+  int kind;
+  int weight_count;
+  double *state; //the velocity, last changes or mean square, per weight
+  double *steps; //RPROP's step sizes
+  double training_level;
+  double momentum; //also the mean square's decay, for ADAPTIVE
+} net_optimizer;
+
+#define NEURAL_ERRSTR_LEN 1024
+
+/* Everything a training run needs which used to be global: the RNG state
+   for starting weights and example order, an error buffer, and scratch
+   space (sized for the net it was last used with).  One context per thread
+   lets several nets train concurrently in one process, and seeding it makes
+   a run reproducible.  The *_r functions below take a context; their
+   counterparts without _r make a fresh, time-seeded one for each call. */
+typedef struct _neural_context_STRUCT {
+  unsigned int rng_state;
+  char errstr[NEURAL_ERRSTR_LEN];
+  net_io state;
+  net_weights weight_changes;
+  net_weights batch_changes; //summed changes of the current mini-batch
+  int *order; //the order examples are presented in
+  int order_count;
+  //structure-of-arrays buffers for calc_net_batch()
+  int *batch_inputs;
+  int *batch_outputs;
+  int batch_size;
+  net_optimizer optimizer; //for TRAIN_OPTIMIZER( kind )
+  /* Budgets for training runs, which may be set after
+     init_neural_context(): a run stops once it has made
+     presentation_budget presentations, or done work_budget work (see
+     training_statistics.work), whichever comes first; 0 is no limit.
+     They are checked between iterations (or chunks, for
+     train_on_stream_r()), as timeout_secs is, but where a run stops
+     doesn't depend on the machine or how busy it is, so with a seed the
+     run repeats exactly. */
+  long presentation_budget;
+  double work_budget;
+} neural_context;
+
+//the error buffer is per thread, so it is only meaningful in the thread
+//which made the failing call
 char *neural_error();
 
+//net_file is either a compiled net SO or a blob (see NetCompiler::Blob)
 int load_net( const char *net_file, net_definition *def );
+//loads one of several nets compiled into net_file, whose functions are
+//suffixed with _<name> (e.g. _calc_net_<name>); a NULL name is load_net(),
+//which also accepts a blob
+#define NET_NAME_MAX 128
+int load_named_net( const char *net_file, const char *name,
+		    net_definition *def );
+//dlclose()s the net SO; def must not be used afterwards
+void unload_net( net_definition *def );
 
 //allocate (zeroed) memory for arrays in net_io structure
 int init_net_io( net_definition *def, net_io *io, int with_internal_state );
 //allocates (zeroed) memory for weights array in structure
 int init_net_weights( net_definition *def, net_weights *weights );
 int starting_weights( net_definition *def, net_weights *weights );
+int starting_weights_r( neural_context *ctx, net_definition *def,
+			net_weights *weights );
+
+//gives io (which needs its node values) feedback state, with the given
+//NET_FEEDBACK_* flags; free_net_io() frees it
+int init_net_feedback( net_definition *def, net_io *io, int flags );
+//adds b's counts to a's
+void add_feedback_stats( net_feedback_stats *a, net_feedback_stats *b );
 
 void free_net_io( net_io *io );
 void free_net_weights( net_weights *weights );
@@ -76,7 +249,27 @@ int test_io_output( net_io *a, net_io *b );
 
 void apply_weights( net_weights *weights, net_weights *changes );
 
+//allocates opt for def's weights, with kind's state at its start
+int init_net_optimizer( net_definition *def, net_optimizer *opt, int kind,
+			double training_level );
+//back to the start, as if just initialized
+void reset_net_optimizer( net_optimizer *opt );
+void free_net_optimizer( net_optimizer *opt );
+//steps weights by opt for changes (from train_net(), or summed)
+void optimize_weights( net_optimizer *opt, net_weights *weights,
+		       net_weights *changes );
+//NET_OPTIMIZER_* for "none", "momentum", "rprop" or "adaptive"; -1 if
+//name is none of those
+int net_optimizer_kind( const char *name );
+
 int calc_net( net_definition *def, net_io *io, net_weights *weights );
+/* Calculates example_count examples at once.  inputs and outputs are in
+   structure-of-arrays layout: inputs[i*example_count + e] is input i of
+   example e.  Uses the net's vectorized _calc_net_batch where it has one,
+   and gives the same outputs as calc_net() on each example. */
+#define NEURAL_BATCH_SIZE 256
+int calc_net_batch( net_definition *def, int *inputs, int *outputs,
+		    int example_count, net_weights *weights );
 
 #define NET_CORRECT_OUTPUTS_GIVEN 2
 #define NET_APPLY_WEIGHT_CHANGES 4
@@ -87,6 +280,23 @@ void train_net( net_definition *def, net_io *io,
 		net_weights *weight_changes,
 		double training_level,
 		unsigned int flags );
+/* Adds io's weight changes to batch_changes, for mini-batches: scratch
+   (allocated with init_net_weights()) holds the example's own changes on
+   the way, so nothing is allocated per example.  Only
+   NET_CORRECT_OUTPUTS_GIVEN in flags applies. */
+void accumulate_changes( net_definition *def, net_io *io,
+			 net_weights *weights, net_weights *scratch,
+			 net_weights *batch_changes,
+			 double training_level, unsigned int flags );
+
+/* With TRAIN_TIMINGS, where a training run's time went, in seconds (for
+   train_on_set_parallel_r(), summed over the threads). */
+typedef struct _training_timings_STRUCT {
+  double forward; //calc_net(), and scoring its outputs
+  double backward; //working out weight changes
+  double apply; //applying them to the weights
+  double shuffle; //ordering the examples and setting them up
+} training_timings;
 
 typedef struct _training_statistics_STRUCT {
   int iteration_count;
@@ -97,9 +307,38 @@ typedef struct _training_statistics_STRUCT {
   float elapsed_seconds;
   float correct_rate;
   float learned_fraction;
+  int update_count; //times the weights were changed
+  /* the arithmetic the run did, estimated in weight visits (about a
+     multiply-add each): weight_count for each presentation, twice that
+     more for each example trained on, and once more for each update */
+  double work;
+  net_feedback_stats feedback; //see net_feedback
+  training_timings timings;
+  int allocations; //made by libneural (in the calling thread) for the run
 } training_statistics;
 
 #define TRAIN_ON_SUCCESS 1
+/* Mini-batches: with TRAIN_BATCH( n ) in flags, train_on_set() sums the
+   weight changes of n presentations (the last batch of each iteration may
+   be shorter) and applies them once, instead of after every example.
+   The changes are summed, not averaged, so training_level keeps its
+   per-example meaning.  n of 0 or 1 is the usual per-example training. */
+#define TRAIN_BATCH_SHIFT 8
+#define TRAIN_BATCH( n ) ( (n) << TRAIN_BATCH_SHIFT )
+//for train_on_set_parallel_r: lock-free updates instead of synchronized
+//batches
+#define TRAIN_HOGWILD 2
+//warm-start feedback relaxations from the previous presentation
+#define TRAIN_WARM_FEEDBACK 4
+//fill in training_statistics.timings (costs a few clock reads per example)
+#define TRAIN_TIMINGS 8
+/* train with an optimizer (NET_OPTIMIZER_*) rather than plain steps; its
+   state is the context's, and starts afresh with each run.  Not with
+   TRAIN_HOGWILD, or for train_replicas_r(). */
+#define TRAIN_OPTIMIZER_SHIFT 4
+#define TRAIN_OPTIMIZER( kind ) ( (kind) << TRAIN_OPTIMIZER_SHIFT )
+#define TRAIN_OPTIMIZER_KIND( flags ) \
+  ( ( (flags) >> TRAIN_OPTIMIZER_SHIFT ) & 15 )
   
 void train_on_set( net_definition *def, 
 		   net_io **training_set, int set_count,
@@ -108,6 +347,105 @@ void train_on_set( net_definition *def,
 		   double timeout_secs,
 		   training_statistics *stats,
 		   int flags );
+int train_on_set_r( neural_context *ctx, net_definition *def,
+		    net_io **training_set, int set_count,
+		    net_weights *weights,
+		    double training_level,
+		    double timeout_secs,
+		    training_statistics *stats,
+		    int flags );
+
+/* train_on_set_r() spread over threads (see parallel.c): each step's
+   examples are shared out, and each thread computes weight changes into its
+   own buffers.  By default a step is a mini-batch (TRAIN_BATCH( n ) in
+   flags, or 16 examples per thread) whose changes are summed and applied
+   once all threads finish, which repeats exactly for a given seed and
+   thread count; with TRAIN_HOGWILD each thread instead updates the shared
+   weights as it goes, without locks.  The statistics are exact either way.
+   threads <= 1 is plain train_on_set_r(). */
+int train_on_set_parallel_r( neural_context *ctx, net_definition *def,
+			     net_io **training_set, int set_count,
+			     net_weights *weights,
+			     double training_level,
+			     double timeout_secs,
+			     training_statistics *stats,
+			     int flags, int threads );
+
+/* count independent weight sets (replicas) of one net, for training
+   together with train_replicas_r().  The replicas are kept in groups of
+   NET_REPLICA_LANES, interleaved within a group so that a net's
+   _train_replicas can work on a group at once, one replica per vector
+   lane: weight w of replica r is
+     weights[( r / NET_REPLICA_LANES * weight_count + w ) * NET_REPLICA_LANES
+	     + r % NET_REPLICA_LANES] */
+typedef struct _net_replicas_STRUCT {
+  double *weights;
+  int weight_count;
+  int count;
+} net_replicas;
+
+int init_net_replicas( net_definition *def, net_replicas *replicas,
+		       int count );
+void free_net_replicas( net_replicas *replicas );
+//copies replica's weights out to weights (allocated if weight_count is 0)
+int get_replica_weights( net_definition *def, net_replicas *replicas,
+			 int replica, net_weights *weights );
+int set_replica_weights( net_replicas *replicas, int replica,
+			 net_weights *weights );
+/* Trains every replica from its own starting weights (drawn from ctx in
+   turn, replica 0 first), in lock-step over the same example order: each
+   iteration is shuffled once, and every replica is shown each example
+   before the next.  Each replica is trained exactly as train_on_set_r()
+   would train it alone, and stops, as that does, once it gets a whole
+   iteration right or uses up ctx's budgets; so with one replica this is
+   train_on_set_r().  With the net's _train_replicas, a group of replicas
+   costs little more than one; without it (blobs, older SOs) they go one
+   at a time.
+   stats gets one training_statistics per replica, and total (if not NULL)
+   their aggregate: counts summed, and rates and fractions over all the
+   replicas' presentations and examples.  Of the flags, TRAIN_ON_SUCCESS
+   applies (an optimizer is an error); feedback groups start cold. */
+int train_replicas_r( neural_context *ctx, net_definition *def,
+		      net_io **training_set, int set_count,
+		      net_replicas *replicas,
+		      double training_level,
+		      double timeout_secs,
+		      training_statistics *stats,
+		      training_statistics *total,
+		      int flags );
+
+/* A training set too big to hold in memory, read from its file as training
+   goes (see stream.c): a background thread reads it chunk_size examples at
+   a time into one of two buffers while training works through the other,
+   and starts over at the end, so memory stays at two chunks however big
+   the set is, and training starts after the first chunk rather than the
+   whole set.  The file is either format load_io_sets() takes; the stream
+   is its first set.  For a binary set the checksum isn't checked, as that
+   would mean reading the whole file first. */
+struct _net_stream_STRUCT;
+typedef struct _net_stream_STRUCT net_stream;
+
+int open_net_stream( const char *fname, net_definition *def, int chunk_size,
+		     net_stream **stream );
+//stops the reader, and frees the stream
+void close_net_stream( net_stream *stream );
+//examples in the streamed set
+int net_stream_count( net_stream *stream );
+
+/* train_on_set_r() over a stream: each iteration is one pass through the
+   file, and the examples are shuffled within each chunk rather than over
+   the whole set, so chunk_size is the shuffle window.  The time limit and
+   ctx's budgets are checked after each chunk, so a run can stop part way
+   through a pass (and the next run on the stream carries on from there);
+   learned_count is from the last whole pass.  The flags are
+   train_on_set_r()'s, and with a seed a run repeats exactly, as there. */
+int train_on_stream_r( neural_context *ctx, net_definition *def,
+		       net_stream *stream,
+		       net_weights *weights,
+		       double training_level,
+		       double timeout_secs,
+		       training_statistics *stats,
+		       int flags );
 
 typedef struct _test_statistics_STRUCT {
   int successful_items;
@@ -121,14 +459,67 @@ void test_on_set( net_definition *def,
 		  net_weights *weights,
 		  test_statistics *stats,
 		  int flags );
+int test_on_set_r( neural_context *ctx, net_definition *def,
+		   net_io **test_set, int set_count,
+		   net_weights *weights,
+		   test_statistics *stats,
+		   int flags );
 		  
 
+/* Writes the statistics of a run as one line of JSON: an object with the
+   net's name and shape ("net", "info"), "training_statistics" (with
+   presentations_per_second, the timings, allocations and feedback
+   sweeps) and, unless test is NULL, "test_statistics".  The fields are
+   named as in the structs. */
+int fwrite_statistics_json( FILE *file, const char *net_name,
+			    net_definition *def,
+			    training_statistics *train,
+			    test_statistics *test );
+//allocations libneural has made in this thread
+int neural_allocation_count();
+
+//a seed made from the time and pid, for when repeatability isn't wanted
+unsigned int neural_seed();
+int init_neural_context( neural_context *ctx, unsigned int seed );
+void free_neural_context( neural_context *ctx );
+//error from the last failed *_r call made with ctx
+char *neural_context_error( neural_context *ctx );
+
 //write weights to filehandle as ascii representation
 int fwrite_weights( FILE *file, net_weights *weights );
 int fread_weights( FILE *file, net_weights *weights );
+/* Binary checkpoints (see neural_weights.h): exact, checksummed, and read
+   back with a single mmap and copy.  save_weights() replaces fname
+   atomically.  load_weights() checks the checkpoint was made for def's
+   net, and allocates weights first if weight_count is 0. */
+int save_weights( const char *fname, net_definition *def, net_weights *weights );
+int load_weights( const char *fname, net_definition *def, net_weights *weights );
+//true if fname is a checkpoint rather than fwrite_weights() text
+int is_weights_checkpoint( const char *fname );
 
 int fwrite_net_io( FILE *file, net_io *io );;
 int fread_net_io( FILE *file, net_io *io );
+/* Reads a set written as a count followed by that many net_io's into one
+   arena: each example's inputs and outputs are a row of set->arena, and
+   its node values (if with_internal_state) a row of set->node_arena.
+   set->items[i] points into the rows, so examples are used in place, and
+   set->ptrs is the net_io ** form which train_on_set() etc take. */
+int fread_io_set( FILE *file, net_io_set *set, net_definition *def,
+		  int with_internal_state );
+//allocates set for count (zeroed) examples of def
+int init_io_set( net_io_set *set, int count, net_definition *def,
+		 int with_internal_state );
+void free_io_set( net_io_set *set );
+/* Loads the first set_count sets (e.g. training then test) from fname into
+   sets[], which may be either the text format fread_io_set() reads, or the
+   binary format written by make_binary_set.pl (see neural_dataset.h);
+   the format is detected from the file. */
+int load_io_sets( const char *fname, net_io_set *sets, int set_count,
+		  net_definition *def, int with_internal_state );
+//loads just set which (0 for the first) of the sets in fname
+int load_io_set( const char *fname, int which, net_io_set *set,
+		 net_definition *def, int with_internal_state );
+//the same, for callers which keep the items and pointers themselves
 int fread_net_io_set( FILE *file, net_io **set_buf, net_io ***set, int *count,
 		      net_definition *def, int with_internal_state );
 
@@ -0,0 +1,92 @@
+#ifndef __NEURAL_BLOB_H
+#define __NEURAL_BLOB_H
+
+#include "neural.h"
+
+/* Interpreter for nets compiled by NetCompiler into the "blob" format.
+   The layout must match perllib/NetCompiler/Blob.pm.  load_net() hands a
+   blob file to load_blob_net(), and calc_net(), train_net() and
+   starting_weights() call the blob_* functions for a net with a blob in
+   place of the compiled functions. */
+
+#define NET_BLOB_MAGIC "NNBL"
+#define NET_BLOB_VERSION 1
+
+#define BLOB_SET_FEEDBACK 1
+#define BLOB_NODE_OUTPUT 1
+#define BLOB_LINK_FB_GROUP 1
+#define BLOB_LINK_RANDOM 2
+
+typedef struct _net_blob_header_STRUCT {
+  char magic[4];
+  int version;
+  int input_count;
+  int output_count;
+  int weight_count;
+  int node_count;
+  int set_count;
+  int node_entry_count;
+  int in_count;
+  int out_count;
+  //the net's own feedback settings (the convergence in millionths), or 0
+  int feedback_limit;
+  int feedback_convergence_ppm;
+} net_blob_header;
+
+typedef struct _blob_set_STRUCT {
+  int flags;
+  int first_node, end_node;
+} blob_set;
+
+typedef struct _blob_node_STRUCT {
+  int node;
+  int flags;
+  int in_start, in_end;
+  int out_start, out_end;
+} blob_node;
+
+typedef struct _blob_link_STRUCT {
+  int node;
+  int weight;
+  int flags;
+} blob_link;
+
+typedef struct _net_blob_STRUCT {
+  net_blob_header head;
+  void *data; //the whole file; the arrays below point into it
+  double *fixed_weights;
+  int *inputs;
+  int *outputs;
+  blob_set *sets;
+  blob_node *nodes;
+  blob_link *ins;
+  blob_link *outs;
+  int feedback_groups;
+} net_blob;
+
+//true if net_file starts with the blob magic number
+int is_net_blob( const char *net_file );
+int load_blob_net( const char *net_file, net_definition *def );
+void free_net_blob( net_blob *blob );
+
+int blob_calc_net( net_blob *blob,
+		   int *inputs, int input_count,
+		   int *outputs, int output_count,
+		   double *weights, int weight_count,
+		   double *node_values, int node_count,
+		   int feedback_limit, double feedback_convergence,
+		   net_feedback *feedback );
+int blob_setup_weights( net_blob *blob, double *weights, int weight_count,
+			unsigned int *seed, int make_seed );
+void blob_train_net( net_blob *blob, double *weights,
+		     double *weight_changes, int weight_count,
+		     double *node_values, int node_count,
+		     int *correct_outputs, int output_count,
+		     int feedback_limit, double feedback_convergence,
+		     double training_level, net_feedback *feedback );
+
+//sets def's feedback_limit and feedback_convergence from its info
+//(neural.c)
+void net_feedback_settings( net_definition *def );
+
+#endif /* __NEURAL_BLOB_H */
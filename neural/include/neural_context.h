@@ -0,0 +1,28 @@
+#ifndef __NEURAL_CONTEXT_H
+#define __NEURAL_CONTEXT_H
+
+#include "neural.h"
+
+//(re)allocates ctx's scratch space for def and a set of set_count items
+int context_scratch( neural_context *ctx, net_definition *def, int set_count );
+//readies ctx's optimizer for a run with the given TRAIN_* flags over
+//set_count examples, at the start of its state; fails for rprop without
+//a batch of the whole set
+int context_optimizer( neural_context *ctx, net_definition *def, int flags,
+		       double training_level, int set_count );
+//makes sure ctx's batch arrays hold NEURAL_BATCH_SIZE examples for def
+int context_batch( neural_context *ctx, net_definition *def );
+//readies state's feedback state (see init_net_feedback()) for a training
+//run with the given TRAIN_* flags
+void start_feedback( net_io *state, int flags );
+//the work (see training_statistics.work) stats' counts add up to for def
+double training_work( net_definition *def, training_statistics *stats );
+//0 once a run with stats so far has used up ctx's budgets, 1 until then
+int within_budget( neural_context *ctx, net_definition *def,
+		   training_statistics *stats );
+//shuffles order[0..n-1] in place with ctx's RNG, so a seeded run repeats
+void shuffle_order( neural_context *ctx, int *order, int n );
+//copies the thread's current neural_error() into ctx
+void context_error( neural_context *ctx );
+
+#endif /* __NEURAL_CONTEXT_H */
@@ -0,0 +1,44 @@
+#ifndef __NEURAL_DATASET_H
+#define __NEURAL_DATASET_H
+
+#include "neural.h"
+
+/* Binary training/test set files, as written by src/make_binary_set.pl:
+
+     header       net_set_header below
+     int          counts[set_count]     examples in each set
+     row          rows[sum of counts]   one per example, set after set
+
+   Each row is row_bytes bytes holding input_count + output_count bits,
+   inputs first, bit k in byte k/8 at (1 << k%8); a set bit is +1 and a
+   clear one -1.  checksum is the 32 bit FNV-1a hash of everything after
+   the header.  Values are native ints, so like a blob, a set file is only
+   good on the kind of machine it was made on. */
+
+#define NET_SET_MAGIC "NNST"
+#define NET_SET_VERSION 1
+
+typedef struct _net_set_header_STRUCT {
+  char magic[4];
+  int version;
+  int input_count;
+  int output_count;
+  int set_count;
+  int row_bytes;
+  unsigned int checksum;
+  int reserved;
+} net_set_header;
+
+//true if fname starts with the set file magic number
+int is_binary_set( const char *fname );
+//loads set_count sets, starting with set first
+int load_binary_sets( const char *fname, net_io_set *sets, int first,
+		      int set_count, net_definition *def,
+		      int with_internal_state );
+//fills set's examples (set->count of them) from rows of row_bytes each
+void unpack_rows( net_io_set *set, const unsigned char *rows,
+		  int row_bytes );
+//reads past a text set (see fread_io_set()) one example at a time
+int skip_io_set( FILE *file, net_definition *def );
+
+#endif /* __NEURAL_DATASET_H */
@@ -0,0 +1,17 @@
+#ifndef __NEURAL_FILE_H
+#define __NEURAL_FILE_H
+
+#include <stddef.h>
+
+/* Helpers shared by libneural's binary files (set files, weight
+   checkpoints). */
+
+//maps fname read-only; sets *map and *size, or the error (for fn) and -1
+int map_file( const char *fn, const char *fname, void **map, size_t *size );
+void unmap_file( void *map, size_t size );
+//32 bit FNV-1a hash, the checksum each binary file carries
+unsigned int file_checksum( const void *data, size_t len );
+//true if fname starts with the 4 byte magic
+int file_has_magic( const char *fname, const char *magic );
+
+#endif /* __NEURAL_FILE_H */
@@ -0,0 +1,47 @@
+#ifndef __NEURAL_STREAM_H
+#define __NEURAL_STREAM_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "neural.h"
+
+/* The insides of a net_stream (see neural.h).  The reader thread fills
+   chunks[] in turn, and the consumer takes them in the same turn; a chunk
+   is the reader's while it isn't filled, and the consumer's from when it
+   is until next_stream_chunk() moves the consumer on to the other one. */
+
+typedef struct _net_stream_chunk_STRUCT {
+  net_io_set set; //chunk_size examples; set.count of them read
+  int filled;
+  int last; //the last chunk of a pass through the file
+} net_stream_chunk;
+
+struct _net_stream_STRUCT {
+  FILE *file;
+  int binary;
+  long start; //where the examples begin in file
+  int row_bytes; //binary sets
+  unsigned char *rows; //one chunk of binary rows, as read
+  int count; //examples in the set
+  int next; //the next one the reader reads
+  int chunk_size;
+  net_stream_chunk chunks[2];
+  int reading; //the chunk the reader fills next
+  int taking; //the chunk the consumer takes next
+  int holding; //the consumer has the chunk before taking
+  int at_start; //the consumer's next chunk is the first of a pass
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int done; //close_net_stream() wants the reader to stop
+  int failed; //the reader stopped on errstr
+  char errstr[NEURAL_ERRSTR_LEN];
+};
+
+/* Gives back the chunk the consumer had (if any), and waits for the next
+   one; *last is set if it ends a pass.  NULL, with the reader's error, if
+   the reader failed. */
+net_io_set *next_stream_chunk( net_stream *stream, int *last );
+
+#endif /* __NEURAL_STREAM_H */
@@ -0,0 +1,27 @@
+#ifndef __NEURAL_TELEMETRY_H
+#define __NEURAL_TELEMETRY_H
+
+#include <stddef.h>
+
+/* Instrumentation shared by the training loops (see telemetry.c). */
+
+//seconds on a monotonic clock
+double neural_clock();
+
+//with timing on, adds the time since *mark to *total and moves the mark
+//on, so consecutive phases of a loop can be charged one after another
+static inline void phase_time( int timed, double *total, double *mark ) {
+  double now;
+  if( timed ) {
+    now = neural_clock();
+    *total += now - *mark;
+    *mark = now;
+  }
+}
+
+//libneural allocates through these, so neural_allocation_count() can
+//count the allocations
+void *neural_malloc( size_t size );
+void *neural_calloc( size_t count, size_t size );
+
+#endif /* __NEURAL_TELEMETRY_H */
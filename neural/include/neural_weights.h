@@ -0,0 +1,31 @@
+#ifndef __NEURAL_WEIGHTS_H
+#define __NEURAL_WEIGHTS_H
+
+#include "neural.h"
+
+/* Binary weight checkpoints, written by save_weights():
+
+     header       net_weights_header below
+     double       weights[weight_count]
+
+   The counts are the net's net_info, so a checkpoint is only loaded into
+   the net it was made from (or another variant of it); checksum is
+   file_checksum() of the weights.  The header is a multiple of 8 bytes,
+   so the weights are aligned in the mapped file.  Native doubles, so only
+   good on the kind of machine that wrote it. */
+
+#define NET_WEIGHTS_MAGIC "NNWT"
+#define NET_WEIGHTS_VERSION 1
+
+typedef struct _net_weights_header_STRUCT {
+  char magic[4];
+  int version;
+  int input_count;
+  int output_count;
+  int weight_count;
+  int node_count;
+  int variant;
+  unsigned int checksum;
+} net_weights_header;
+
+#endif /* __NEURAL_WEIGHTS_H */
@@ -1,8 +1,12 @@
 #include <stdlib.h>
+#include <string.h>
 #include <dlfcn.h>
 
 #include "neural.h"
 #include "neural_err.h"
+#include "neural_telemetry.h"
+#include "neural_context.h"
+#include "neural_blob.h"
 
 int _get_net_fn( void *net, char *fn_name, void **fn_ptr ) {
   char *error;
@@ -17,8 +21,32 @@ int _get_net_fn( void *net, char *fn_name, void **fn_ptr ) {
 }
 
 int load_net( const char *net_file, net_definition *def ) {
+  return load_named_net( net_file, NULL, def );
+}
+
+int load_named_net( const char *net_file, const char *name,
+		    net_definition *def ) {
   void *net;
   char *error;
+  //function names plus "_<name>":
+  char info_fn[NET_NAME_MAX + 32], calc_fn[NET_NAME_MAX + 32];
+  char setup_fn[NET_NAME_MAX + 32], train_fn[NET_NAME_MAX + 32];
+  const char *sep = "_";
+
+  if( name == NULL ) {
+    if( is_net_blob( net_file ) ) {
+      return load_blob_net( net_file, def );
+    }
+    name = sep = "";
+  }
+  if( strlen( name ) > NET_NAME_MAX ) {
+    sprintf_neural_err( "load_named_net: net name too long (%s)", name );
+    return -1;
+  }
+  sprintf( info_fn, "_net_info%s%s", sep, name );
+  sprintf( calc_fn, "_calc_net%s%s", sep, name );
+  sprintf( setup_fn, "_setup_initial_weights%s%s", sep, name );
+  sprintf( train_fn, "_train_net%s%s", sep, name );
 
   dlerror();
   net = dlopen( net_file, RTLD_NOW );
@@ -28,44 +56,87 @@ int load_net( const char *net_file, net_definition *def ) {
     return -1;
   }
   def->dlref = net;
+  def->blob = NULL;
 
   //load functions from the network SO
-  if( _get_net_fn( net, "_net_info", (void **)&def->get_info ) ||
-      _get_net_fn( net, "_calc_net", (void **)&def->calculate ) ||
-      _get_net_fn( net, "_setup_initial_weights", (void **)&def->setup_weights ) ||
-      _get_net_fn( net, "_train_net", (void **)&def->train ) ) {
+  if( _get_net_fn( net, info_fn, (void **)&def->get_info ) ||
+      _get_net_fn( net, calc_fn, (void **)&def->calculate ) ||
+      _get_net_fn( net, setup_fn, (void **)&def->setup_weights ) ||
+      _get_net_fn( net, train_fn, (void **)&def->train ) ) {
     //error already set by _get_net_fn() above
+    unload_net( def );
     return -1;
   }
+  //optional, so no error if it's missing
+  sprintf( calc_fn, "_calc_net_batch%s%s", sep, name );
+  def->calculate_batch = (calc_network_batch_fn)dlsym( net, calc_fn );
+  sprintf( calc_fn, "_calc_net_fb%s%s", sep, name );
+  def->calculate_fb = (calc_network_fb_fn)dlsym( net, calc_fn );
+  sprintf( train_fn, "_train_net_fb%s%s", sep, name );
+  def->train_fb = (train_net_fb_fn)dlsym( net, train_fn );
+  sprintf( train_fn, "_train_replicas%s%s", sep, name );
+  def->train_replicas = (train_replicas_fn)dlsym( net, train_fn );
+  dlerror();
 
+  //older nets don't set the later fields
+  memset( (void *)&def->info, 0, sizeof( struct net_info ) );
   def->get_info( &def->info );
-  //maybe let the network set these?
-  def->feedback_limit = 1000;
-  def->feedback_convergence = 0.05;
+  net_feedback_settings( def );
   return 0;
 }
 
+void net_feedback_settings( net_definition *def ) {
+  //a net can ask for fewer sweeps than the default, but not more, and a
+  //convergence of 1 or more would stop every relaxation after one sweep
+  def->feedback_limit = def->info.feedback_limit > 0 &&
+    def->info.feedback_limit < NET_DEFAULT_FEEDBACK_LIMIT ?
+    def->info.feedback_limit : NET_DEFAULT_FEEDBACK_LIMIT;
+  def->feedback_convergence = def->info.feedback_convergence > 0 ?
+    def->info.feedback_convergence : NET_DEFAULT_FEEDBACK_CONVERGENCE;
+  if( def->feedback_convergence > NET_MAX_FEEDBACK_CONVERGENCE ) {
+    def->feedback_convergence = NET_MAX_FEEDBACK_CONVERGENCE;
+  }
+}
+
+void unload_net( net_definition *def ) {
+  if( def->dlref ) {
+    dlclose( def->dlref );
+  }
+  free_net_blob( def->blob );
+  def->dlref = NULL;
+  def->blob = NULL;
+  def->calculate = NULL;
+  def->setup_weights = NULL;
+  def->train = NULL;
+  def->get_info = NULL;
+  def->calculate_batch = NULL;
+  def->calculate_fb = NULL;
+  def->train_fb = NULL;
+  def->train_replicas = NULL;
+}
+
 int init_net_io( net_definition *def, net_io *io, int with_internal_state ) {
   char *fn = "init_net_io";
   io->input_count = 0;
   io->output_count = 0;
   io->node_count = 0;
   io->node_values = NULL; /*this may not otherwise be assigned a value*/
+  io->feedback = NULL;
   
-  io->inputs = (int *)calloc( def->info.input_count, sizeof(int) );
+  io->inputs = (int *)neural_calloc( def->info.input_count, sizeof(int) );
   if( ! io->inputs ) {
     ERRNO_OUT( fn, "Can't allocate inputs array" );
   }
   io->input_count = def->info.input_count;
 
-  io->outputs = (int *)calloc( def->info.output_count, sizeof(int) );
+  io->outputs = (int *)neural_calloc( def->info.output_count, sizeof(int) );
   if( ! io->outputs ) {
     ERRNO_OUT( fn, "Can't allocate outputs array" );
   }
   io->output_count = def->info.output_count;
 
   if( with_internal_state ) {
-    io->node_values = (double *)calloc( def->info.node_count, sizeof(double) );
+    io->node_values = (double *)neural_calloc( def->info.node_count, sizeof(double) );
     if( ! io->node_values ) {
       ERRNO_OUT( fn, "Can't allocate node values" );
     }
@@ -78,7 +149,7 @@ int init_net_weights( net_definition *def, net_weights *weights ) {
   unsigned int seed = 0;
   weights->weight_count = 0;
 
-  weights->weights = (double *)calloc( def->info.weight_count, sizeof(double) );
+  weights->weights = (double *)neural_calloc( def->info.weight_count, sizeof(double) );
   if( !weights->weights ) {
     ERRNO_OUT( "init_net_weights", "Can't allocate weights array" );
   }
@@ -91,9 +162,65 @@ int starting_weights( net_definition *def, net_weights *weights ) {
     //err already set
     return -1;
   }
+  if( def->blob ) {
+    return blob_setup_weights( def->blob, weights->weights,
+			       weights->weight_count, NULL, 1 );
+  }
   return def->setup_weights( weights->weights, weights->weight_count, NULL, 1 );
 }
+
+int starting_weights_r( neural_context *ctx, net_definition *def,
+			net_weights *weights ) {
+  if( 0 > init_net_weights( def, weights ) ) {
+    context_error( ctx );
+    return -1;
+  }
+  //draws from (and advances) the context's RNG
+  if( 0 > ( def->blob ?
+	    blob_setup_weights( def->blob, weights->weights,
+				weights->weight_count, &ctx->rng_state, 0 ) :
+	    def->setup_weights( weights->weights, weights->weight_count,
+				&ctx->rng_state, 0 ) ) ) {
+    sprintf_neural_err( "starting_weights_r: net rejected weight_count %d",
+			weights->weight_count );
+    context_error( ctx );
+    return -1;
+  }
+  return 0;
+}
   
+int init_net_feedback( net_definition *def, net_io *io, int flags ) {
+  char *fn = "init_net_feedback";
+
+  if( io->node_count != def->info.node_count ) {
+    ERR_OUT( fn, "net_io has no node values" );
+  }
+  io->feedback = (net_feedback *)neural_calloc( 1, sizeof( net_feedback ) );
+  if( !io->feedback ) {
+    ERRNO_OUT( fn, "Can't allocate feedback state" );
+  }
+  io->feedback->errors = (double *)neural_calloc( def->info.node_count + 1,
+					   sizeof(double) );
+  if( !io->feedback->errors ) {
+    free( io->feedback );
+    io->feedback = NULL;
+    ERRNO_OUT( fn, "Can't allocate feedback errors" );
+  }
+  io->feedback->node_count = def->info.node_count;
+  io->feedback->flags = flags;
+  return 0;
+}
+
+void add_feedback_stats( net_feedback_stats *a, net_feedback_stats *b ) {
+  int i;
+
+  for( i = 0; i < NET_FEEDBACK_STATS; i++ ) {
+    a->sweeps[i] += b->sweeps[i];
+    a->error_sweeps[i] += b->error_sweeps[i];
+  }
+  a->unsettled += b->unsettled;
+}
+
 void free_net_io( net_io *io ) {
   if( io->inputs && io->input_count ) {
     free( io->inputs );
@@ -104,6 +231,11 @@ void free_net_io( net_io *io ) {
   if( io->node_values && io->node_count ) {
     free( io->node_values );
   }
+  if( io->feedback ) {
+    free( io->feedback->errors );
+    free( io->feedback );
+    io->feedback = NULL;
+  }
 }
 
 void free_net_weights( net_weights *weights ) {
@@ -153,6 +285,22 @@ int test_io_output( net_io *a, net_io *b ) {
 }
 
 int calc_net( net_definition *def, net_io *io, net_weights *weights ) {
+  if( def->blob ) {
+    return blob_calc_net( def->blob, io->inputs, io->input_count,
+			  io->outputs, io->output_count,
+			  weights->weights, weights->weight_count,
+			  io->node_values, io->node_count,
+			  def->feedback_limit, def->feedback_convergence,
+			  io->feedback );
+  }
+  if( def->calculate_fb ) {
+    return def->calculate_fb( io->inputs, io->input_count,
+			      io->outputs, io->output_count,
+			      weights->weights, weights->weight_count,
+			      io->node_values, io->node_count,
+			      def->feedback_limit, def->feedback_convergence,
+			      io->feedback );
+  }
   return def->calculate( io->inputs, io->input_count,
 			 io->outputs, io->output_count,
 			 weights->weights, weights->weight_count,
@@ -160,39 +308,106 @@ int calc_net( net_definition *def, net_io *io, net_weights *weights ) {
 			 def->feedback_limit, def->feedback_convergence );
 }
 
+int calc_net_batch( net_definition *def, int *inputs, int *outputs,
+		    int example_count, net_weights *weights ) {
+  int in[def->info.input_count + 1], out[def->info.output_count + 1];
+  net_io io;
+  int e, i;
+
+  if( def->calculate_batch ) {
+    return def->calculate_batch( inputs, def->info.input_count,
+				 outputs, def->info.output_count,
+				 weights->weights, weights->weight_count,
+				 example_count,
+				 def->feedback_limit, def->feedback_convergence );
+  }
+  //no batch function (a blob, or an older SO): one example at a time
+  memset( (void *)&io, 0, sizeof( net_io ) );
+  io.inputs = in;
+  io.input_count = def->info.input_count;
+  io.outputs = out;
+  io.output_count = def->info.output_count;
+  for( e = 0; e < example_count; e++ ) {
+    for( i = 0; i < io.input_count; i++ ) {
+      in[i] = inputs[i * example_count + e];
+    }
+    if( 0 > calc_net( def, &io, weights ) ) {
+      return -1;
+    }
+    for( i = 0; i < io.output_count; i++ ) {
+      outputs[i * example_count + e] = out[i];
+    }
+  }
+  return 0;
+}
+
+//runs the net's training pass for io, leaving the changes in changes
+static void net_changes( net_definition *def, net_io *io,
+			 net_weights *weights, net_weights *changes,
+			 double training_level, unsigned int flags ) {
+  int *correct_outputs = NULL;
+  if( flags & NET_CORRECT_OUTPUTS_GIVEN ) {
+    correct_outputs = io->outputs;
+  }
+  if( def->blob ) {
+    blob_train_net( def->blob, weights->weights,
+		    changes->weights, changes->weight_count,
+		    io->node_values, io->node_count,
+		    correct_outputs, io->output_count,
+		    def->feedback_limit, def->feedback_convergence,
+		    training_level, io->feedback );
+  } else if( def->train_fb ) {
+    def->train_fb( weights->weights,
+		   changes->weights, changes->weight_count,
+		   io->node_values, io->node_count,
+		   correct_outputs, io->output_count,
+		   def->feedback_limit, def->feedback_convergence,
+		   training_level, io->feedback );
+  } else {
+    def->train( weights->weights,
+		changes->weights, changes->weight_count,
+		io->node_values, io->node_count,
+		correct_outputs, io->output_count,
+		def->feedback_limit, def->feedback_convergence,
+		training_level );
+  }
+}
+
 void train_net( net_definition *def, net_io *io,
 		net_weights *weights,
 		net_weights *weight_changes,
 		double training_level,
 		unsigned int flags ) {
-  int *correct_outputs = NULL;
-  net_weights temp_wght;
-  net_weights *wght;
-  if( flags & NET_CORRECT_OUTPUTS_GIVEN ) {
-    correct_outputs = io->outputs;
-  }
+  net_weights scratch;
+
   if( flags & NET_ACCUMULATE_WEIGHT_CHANGES ) {
-    if( 0 != init_net_weights( def, &temp_wght ) ) {
+    //training loops should keep their own scratch and call
+    //accumulate_changes() instead of allocating here every time
+    if( 0 != init_net_weights( def, &scratch ) ) {
       return;
     }
-    wght = &temp_wght;
-  } else {
-    wght = weight_changes;
-  }
-  def->train( weights->weights,
-	      wght->weights, wght->weight_count,
-	      io->node_values, io->node_count,
-	      correct_outputs, io->output_count,
-	      def->feedback_limit, def->feedback_convergence,
-	      training_level );
-  if( flags & NET_APPLY_WEIGHT_CHANGES ) {
-    apply_weights( weights, wght );
+    accumulate_changes( def, io, weights, &scratch, weight_changes,
+			training_level, flags );
+    if( flags & NET_APPLY_WEIGHT_CHANGES ) {
+      apply_weights( weights, &scratch );
+    }
+    free_net_weights( &scratch );
+    return;
   }
-  if( flags & NET_ACCUMULATE_WEIGHT_CHANGES ) {
-    apply_weights( weight_changes, &temp_wght );
+  net_changes( def, io, weights, weight_changes, training_level, flags );
+  if( flags & NET_APPLY_WEIGHT_CHANGES ) {
+    apply_weights( weights, weight_changes );
   }
 }
 
+void accumulate_changes( net_definition *def, net_io *io,
+			 net_weights *weights, net_weights *scratch,
+			 net_weights *batch_changes,
+			 double training_level, unsigned int flags ) {
+  net_changes( def, io, weights, scratch, training_level, flags );
+  apply_weights( batch_changes, scratch );
+}
+
 void apply_weights( net_weights *weights, net_weights *changes ) {
   int i;
 
@@ -209,7 +424,7 @@ int fwrite_weights( FILE *file, net_weights *weights ) {
     ERRNO_OUT( fn, "can't write weight_count" );
   //now write the weights:
   for( i=0; i<weights->weight_count; i++ ) {
-    if( 0 > fprintf( file, "%0.10e\n", weights->weights[i] ) )
+    if( 0 > fprintf( file, "%0.17e\n", weights->weights[i] ) )
       ERRNO_OUT( fn, "can't write next weight" );
   }
   return 0;
@@ -223,7 +438,7 @@ int fread_weights( FILE *file, net_weights *weights ) {
   if( weights->weight_count != count )
     ERR_OUT( fn, "weight_count in file != weight_count in struct" );
   for( i=0; i<count; i++ ) {
-    if( 0 > fscanf( file, "%e", weights->weights + i ) )
+    if( 0 > fscanf( file, "%le", weights->weights + i ) )
       ERRNO_OUT( fn, "can't read next weight" );
   }
   return 0;
@@ -278,11 +493,11 @@ int fread_net_io( FILE *file, net_io *io ) {
   }
   if( io->node_count == 0 ) {
     for( i = 0; i < node_count; i++ ) {
-      fscanf( file, "%e", &node_dummy );
+      fscanf( file, "%le", &node_dummy );
     }
   } else {
     for( i = 0; i < io->node_count; i++ ) {
-      if( 0 > fscanf( file, "%e", io->node_values + i ) )
+      if( 0 > fscanf( file, "%le", io->node_values + i ) )
 	ERRNO_OUT( fn, "can't read node value" );
     }
   }
@@ -291,38 +506,86 @@ int fread_net_io( FILE *file, net_io *io ) {
 
 
 
-int fread_net_io_set( FILE *file, net_io **set_buf, net_io ***set, int *count, 
-		      net_definition *def, int with_internal_state ) {
-  int set_count,i;
-  net_io *cur, **ptrs;
-  char *fn = "fread_net_io_set";
-  *count = 0;
+int init_io_set( net_io_set *set, int count, net_definition *def,
+		 int with_internal_state ) {
+  int i;
+  int in = def->info.input_count, out = def->info.output_count;
+  int nodes = with_internal_state ? def->info.node_count : 0;
+  net_io *cur;
+  char *fn = "init_io_set";
 
-  if( 0 > fscanf( file, "%d", &set_count ) ) {
-    sprintf_neural_err( "%s: %s: %s", fn, "unable to allocate set arrays", 
-			strerror( errno ) ); 
-    return -1;
+  memset( (void *)set, 0, sizeof( net_io_set ) );
+  //one row of in+out ints per example, plus a row of node values if wanted
+  set->items = (net_io *)neural_calloc( count + 1, sizeof( net_io ) );
+  set->ptrs = (net_io **)neural_calloc( count + 1, sizeof( net_io * ) );
+  set->arena = (int *)neural_calloc( (size_t)count * ( in + out ) + 1, sizeof( int ) );
+  if( nodes ) {
+    set->node_arena = (double *)neural_calloc( (size_t)count * nodes + 1, sizeof( double ) );
+  }
+  if( !set->items || !set->ptrs || !set->arena ||
+      ( nodes && !set->node_arena ) ) {
+    free_io_set( set );
+    ERRNO_OUT( fn, "unable to allocate set arrays" );
   }
 
-  *set_buf = (net_io *)calloc( set_count, sizeof( net_io ) ); 
-  if( *set_buf )
-    *set = (net_io **)calloc( set_count, sizeof( net_io * ) );
-
-  if( !*set_buf || !*set) {
-    ERRNO_OUT( fn, "unable to allocate set arrays" );
+  for( i = 0; i < count; i++ ) {
+    cur = set->items + i;
+    cur->inputs = set->arena + (size_t)i * ( in + out );
+    cur->input_count = in;
+    cur->outputs = cur->inputs + in;
+    cur->output_count = out;
+    if( nodes ) {
+      cur->node_values = set->node_arena + (size_t)i * nodes;
+      cur->node_count = nodes;
+    }
+    set->ptrs[i] = cur;
   }
-  ptrs = *set;
+  set->count = count;
+  return 0;
+}
 
-  for( i=0; i<set_count; i++ ) {
-    cur = *set_buf + i;
-    //errors below here already set by called functions
-    if( 0 > init_net_io( def, cur, with_internal_state ) )
-      return -1;
-    if( 0 > fread_net_io( file, cur ) )
+int fread_io_set( FILE *file, net_io_set *set, net_definition *def,
+		 int with_internal_state ) {
+  int set_count, i;
+  char *fn = "fread_io_set";
+
+  memset( (void *)set, 0, sizeof( net_io_set ) );
+  if( 1 != fscanf( file, "%d", &set_count ) || set_count < 0 ) {
+    ERR_OUT( fn, "can't read set count" );
+  }
+  if( 0 > init_io_set( set, set_count, def, with_internal_state ) ) {
+    return -1;
+  }
+  for( i = 0; i < set_count; i++ ) {
+    if( 0 > fread_net_io( file, set->items + i ) ) {
+      //error already set by fread_net_io()
+      free_io_set( set );
       return -1;
-    (*count)++;
-    ptrs[i] = cur;
-    
+    }
+  }
+  return 0;
+}
+
+void free_io_set( net_io_set *set ) {
+  free( set->items );
+  free( set->ptrs );
+  free( set->arena );
+  free( set->node_arena );
+  memset( (void *)set, 0, sizeof( net_io_set ) );
+}
+
+int fread_net_io_set( FILE *file, net_io **set_buf, net_io ***set, int *count, 
+		      net_definition *def, int with_internal_state ) {
+  net_io_set s;
+
+  *count = 0;
+  if( 0 > fread_io_set( file, &s, def, with_internal_state ) ) {
+    return -1;
   }
+  //the caller gets the items and pointers; the arenas live as long as the
+  //process, as the per-example arrays did before
+  *set_buf = s.items;
+  *set = s.ptrs;
+  *count = s.count;
   return 0;
 }
@@ -0,0 +1,139 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_telemetry.h"
+
+/* The optimizers behind TRAIN_OPTIMIZER (see net_optimizer in neural.h).
+   Each works from the changes train_net() computes, which are already
+   scaled by training_level and point downhill, so with no optimizer
+   optimize_weights() is just apply_weights(). */
+
+#define NET_MOMENTUM 0.9
+//iRprop-'s step size factors and bounds; steps start at RPROP_STEP_START
+//times training_level
+#define RPROP_STEP_START 0.1
+#define RPROP_GROW 1.2
+#define RPROP_SHRINK 0.5
+#define RPROP_STEP_MAX 50.0
+#define RPROP_STEP_MIN 1e-6
+//keeps ADAPTIVE's scale finite for a weight whose changes were all 0
+#define ADAPTIVE_EPSILON 1e-8
+
+static char *optimizer_names[NET_OPTIMIZER_COUNT] = {
+  "none", "momentum", "rprop", "adaptive"
+};
+
+int net_optimizer_kind( const char *name ) {
+  int kind;
+
+  for( kind = 0; kind < NET_OPTIMIZER_COUNT; kind++ ) {
+    if( 0 == strcmp( name, optimizer_names[kind] ) ) {
+      return kind;
+    }
+  }
+  return -1;
+}
+
+int init_net_optimizer( net_definition *def, net_optimizer *opt, int kind,
+			double training_level ) {
+  char *fn = "init_net_optimizer";
+
+  memset( (void *)opt, 0, sizeof( net_optimizer ) );
+  if( kind < 0 || kind >= NET_OPTIMIZER_COUNT ) {
+    ERR_OUT( fn, "no such optimizer" );
+  }
+  opt->kind = kind;
+  opt->training_level = training_level;
+  opt->momentum = NET_MOMENTUM;
+  if( kind == NET_OPTIMIZER_NONE ) {
+    return 0;
+  }
+  opt->state = (double *)neural_calloc( def->info.weight_count + 1,
+					sizeof( double ) );
+  if( kind == NET_OPTIMIZER_RPROP ) {
+    opt->steps = (double *)neural_calloc( def->info.weight_count + 1,
+					  sizeof( double ) );
+  }
+  if( !opt->state || ( kind == NET_OPTIMIZER_RPROP && !opt->steps ) ) {
+    free( opt->state );
+    free( opt->steps );
+    opt->state = opt->steps = NULL;
+    ERRNO_OUT( fn, "Can't allocate optimizer state" );
+  }
+  opt->weight_count = def->info.weight_count;
+  reset_net_optimizer( opt );
+  return 0;
+}
+
+void reset_net_optimizer( net_optimizer *opt ) {
+  int i;
+
+  if( opt->state ) {
+    memset( (void *)opt->state, 0, sizeof( double ) * opt->weight_count );
+  }
+  if( opt->steps ) {
+    for( i = 0; i < opt->weight_count; i++ ) {
+      opt->steps[i] = RPROP_STEP_START * opt->training_level;
+    }
+  }
+}
+
+void free_net_optimizer( net_optimizer *opt ) {
+  free( opt->state );
+  free( opt->steps );
+  memset( (void *)opt, 0, sizeof( net_optimizer ) );
+}
+
+void optimize_weights( net_optimizer *opt, net_weights *weights,
+		       net_weights *changes ) {
+  double *w = weights->weights, *d = changes->weights;
+  double *s = opt->state, *step = opt->steps;
+  double mu = opt->momentum, level = opt->training_level;
+  int i, n = weights->weight_count;
+
+  switch( opt->kind ) {
+  case NET_OPTIMIZER_MOMENTUM:
+    for( i = 0; i < n; i++ ) {
+      s[i] = mu * s[i] + d[i];
+      w[i] += s[i];
+    }
+    break;
+  case NET_OPTIMIZER_RPROP:
+    //s holds each weight's last changes (0 after a flip)
+    for( i = 0; i < n; i++ ) {
+      if( d[i] == 0 ) {
+	continue;
+      }
+      if( d[i] * s[i] > 0 ) {
+	step[i] *= RPROP_GROW;
+	if( step[i] > RPROP_STEP_MAX ) {
+	  step[i] = RPROP_STEP_MAX;
+	}
+      } else if( d[i] * s[i] < 0 ) {
+	//overshot: take a smaller step next time, and none this time
+	step[i] *= RPROP_SHRINK;
+	if( step[i] < RPROP_STEP_MIN ) {
+	  step[i] = RPROP_STEP_MIN;
+	}
+	s[i] = 0;
+	continue;
+      }
+      s[i] = d[i];
+      w[i] += ( d[i] > 0 ) ? step[i] : -step[i];
+    }
+    break;
+  case NET_OPTIMIZER_ADAPTIVE:
+    //s is the mean square of the changes; a weight whose changes are
+    //steady steps by about training_level
+    for( i = 0; i < n; i++ ) {
+      s[i] = mu * s[i] + ( 1 - mu ) * d[i] * d[i];
+      w[i] += level * d[i] / ( sqrt( s[i] ) + ADAPTIVE_EPSILON );
+    }
+    break;
+  default:
+    apply_weights( weights, changes );
+  }
+}
@@ -0,0 +1,350 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_telemetry.h"
+#include "neural_context.h"
+
+/* Data-parallel train_on_set: every step, a range of the iteration's
+   (shuffled) order is split among the threads, each of which presents its
+   share of the examples with its own net_io and weight change buffers.
+
+   Synchronous mode: a step is one mini-batch.  The threads all read the
+   same weights, each sums its examples' changes into its own buffer, and
+   once every thread is done the buffers are applied in thread order, so a
+   run repeats exactly for a given seed and thread count.
+
+   TRAIN_HOGWILD: a step is the whole iteration, and each thread applies
+   its changes straight to the shared weights after every example, without
+   locking (as in Hogwild!).  Faster, but not repeatable.
+
+   In either mode the statistics are counted per thread and summed, so they
+   are exact. */
+
+//a reusable barrier whose party count can be cut if threads fail to start
+typedef struct _train_barrier_STRUCT {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int count, waiting, generation;
+} train_barrier;
+
+struct _train_job_STRUCT;
+
+typedef struct _train_worker_STRUCT {
+  struct _train_job_STRUCT *job;
+  int id;
+  pthread_t thread;
+  net_io state;
+  net_weights scratch;
+  net_weights changes; //synchronous mode: this thread's share of the batch
+  int presentations, correct, trained, failures;
+  training_timings timings;
+} train_worker;
+
+typedef struct _train_job_STRUCT {
+  net_definition *def;
+  net_io **set;
+  int *order;
+  net_weights *weights;
+  double training_level;
+  int flags;
+  int threads;
+  int start, end; //the range of order[] for the current step
+  int done;
+  train_barrier barrier;
+  train_worker *workers;
+} train_job;
+
+static void barrier_wait( train_barrier *b ) {
+  int generation;
+
+  pthread_mutex_lock( &b->lock );
+  generation = b->generation;
+  if( ++b->waiting >= b->count ) {
+    b->waiting = 0;
+    b->generation++;
+    pthread_cond_broadcast( &b->cond );
+  } else {
+    while( generation == b->generation ) {
+      pthread_cond_wait( &b->cond, &b->lock );
+    }
+  }
+  pthread_mutex_unlock( &b->lock );
+}
+
+static void barrier_set_count( train_barrier *b, int count ) {
+  pthread_mutex_lock( &b->lock );
+  b->count = count;
+  if( b->waiting >= b->count ) {
+    b->waiting = 0;
+    b->generation++;
+    pthread_cond_broadcast( &b->cond );
+  }
+  pthread_mutex_unlock( &b->lock );
+}
+
+//presents this worker's share of order[start..end)
+static void run_shard( train_worker *w ) {
+  train_job *job = w->job;
+  int n = job->end - job->start;
+  int lo = job->start + (int)( (long long)n * w->id / job->threads );
+  int hi = job->start + (int)( (long long)n * ( w->id + 1 ) / job->threads );
+  net_io view = w->state, *example;
+  int i, do_training;
+  int timed = job->flags & TRAIN_TIMINGS;
+  double mark = timed ? neural_clock() : 0;
+
+  for( i = lo; i < hi; i++ ) {
+    example = job->set[job->order[i]];
+    view.inputs = example->inputs;
+    view.outputs = w->state.outputs;
+    calc_net( job->def, &view, job->weights );
+    w->presentations++;
+    do_training = 0;
+    if( 0 < test_io_output( &view, example ) ) {
+      w->correct++;
+      if( job->flags & TRAIN_ON_SUCCESS ) {
+	do_training = 1;
+      }
+    } else {
+      do_training = 1;
+      w->failures++;
+    }
+    phase_time( timed, &w->timings.forward, &mark );
+    if( do_training ) {
+      view.outputs = example->outputs;
+      w->trained++;
+      if( job->flags & TRAIN_HOGWILD ) {
+	train_net( job->def, &view, job->weights, &w->scratch,
+		   job->training_level, NET_CORRECT_OUTPUTS_GIVEN );
+	phase_time( timed, &w->timings.backward, &mark );
+	apply_weights( job->weights, &w->scratch );
+	phase_time( timed, &w->timings.apply, &mark );
+      } else {
+	accumulate_changes( job->def, &view, job->weights, &w->scratch,
+			    &w->changes, job->training_level,
+			    NET_CORRECT_OUTPUTS_GIVEN );
+	phase_time( timed, &w->timings.backward, &mark );
+      }
+    }
+  }
+}
+
+static void *train_worker_main( void *arg ) {
+  train_worker *w = (train_worker *)arg;
+  train_job *job = w->job;
+
+  for( ;; ) {
+    barrier_wait( &job->barrier );
+    if( job->done ) {
+      break;
+    }
+    run_shard( w );
+    barrier_wait( &job->barrier );
+  }
+  return NULL;
+}
+
+//runs one step on every thread (the caller is worker 0)
+static void run_step( train_job *job, int start, int end ) {
+  job->start = start;
+  job->end = end;
+  barrier_wait( &job->barrier );
+  run_shard( job->workers );
+  barrier_wait( &job->barrier );
+}
+
+static void free_workers( train_worker *workers, int count ) {
+  int i;
+
+  for( i = 0; i < count; i++ ) {
+    free_net_io( &workers[i].state );
+    free_net_weights( &workers[i].scratch );
+    free_net_weights( &workers[i].changes );
+  }
+  free( workers );
+}
+
+int train_on_set_parallel_r( neural_context *ctx, net_definition *def,
+			     net_io **training_set, int set_count,
+			     net_weights *weights,
+			     double training_level,
+			     double timeout_secs,
+			     training_statistics *stats,
+			     int flags, int threads ) {
+  struct timeval start_tv, stop_tv, cur_tv;
+  train_job job;
+  train_worker *w;
+  int *order;
+  int i, t, started, step, failures = 1, trained;
+  int batch = flags >> TRAIN_BATCH_SHIFT;
+  int timed = flags & TRAIN_TIMINGS;
+  double mark = 0;
+  char *fn = "train_on_set_parallel_r";
+
+  if( threads <= 1 ) {
+    return train_on_set_r( ctx, def, training_set, set_count, weights,
+			   training_level, timeout_secs, stats, flags );
+  }
+  memset( (void *)stats, 0, sizeof( training_statistics ) );
+  stats->allocations = neural_allocation_count();
+  if( 0 > context_scratch( ctx, def, set_count ) ) {
+    context_error( ctx );
+    return -1;
+  }
+  if( ( flags & TRAIN_HOGWILD ) && TRAIN_OPTIMIZER_KIND( flags ) ) {
+    sprintf_neural_err( "%s: an optimizer needs synchronized batches, not "
+			"TRAIN_HOGWILD", fn );
+    context_error( ctx );
+    return -1;
+  }
+  if( 0 > context_optimizer( ctx, def, flags, training_level, set_count ) ) {
+    context_error( ctx );
+    return -1;
+  }
+  if( 0 > starting_weights_r( ctx, def, weights ) ) {
+    return -1;
+  }
+  order = ctx->order;
+  for( i = 0; i < set_count; i++ ) {
+    order[i] = i;
+  }
+  if( flags & TRAIN_HOGWILD ) {
+    step = set_count;
+  } else {
+    //without a batch size, enough per thread to be worth the sync
+    step = ( batch > 1 ) ? batch : 16 * threads;
+  }
+
+  memset( (void *)&job, 0, sizeof( train_job ) );
+  job.def = def;
+  job.set = training_set;
+  job.order = order;
+  job.weights = weights;
+  job.training_level = training_level;
+  job.flags = flags;
+  job.threads = threads;
+  job.workers = (train_worker *)neural_calloc( threads, sizeof( train_worker ) );
+  if( !job.workers ) {
+    sprintf_neural_err( "%s: can't allocate workers", fn );
+    context_error( ctx );
+    return -1;
+  }
+  for( t = 0; t < threads; t++ ) {
+    w = job.workers + t;
+    w->job = &job;
+    w->id = t;
+    if( 0 > init_net_io( def, &w->state, 1 ) ||
+	0 > init_net_feedback( def, &w->state, 0 ) ||
+	0 > init_net_weights( def, &w->scratch ) ||
+	0 > init_net_weights( def, &w->changes ) ) {
+      free_workers( job.workers, threads );
+      context_error( ctx );
+      return -1;
+    }
+    start_feedback( &w->state, flags );
+  }
+  pthread_mutex_init( &job.barrier.lock, NULL );
+  pthread_cond_init( &job.barrier.cond, NULL );
+  job.barrier.count = threads;
+  //worker 0 is this thread
+  for( started = 1; started < threads; started++ ) {
+    if( pthread_create( &job.workers[started].thread, NULL,
+			train_worker_main, job.workers + started ) ) {
+      break;
+    }
+  }
+  //carry on with the threads we got
+  job.threads = started;
+  barrier_set_count( &job.barrier, started );
+
+  gettimeofday( &start_tv, (struct timezone *)NULL );
+
+  while( gettimeofday( &cur_tv, NULL ) == 0 &&
+	 timeout_secs >
+	 (double)( cur_tv.tv_sec - start_tv.tv_sec ) +
+	 ( (double)( cur_tv.tv_usec - start_tv.tv_usec ) / 1000000 ) &&
+	 failures > 0 && within_budget( ctx, def, stats ) ) {
+    stats->iteration_count++;
+    if( timed ) {
+      mark = neural_clock();
+    }
+    //the same order train_on_set_r would take
+    shuffle_order( ctx, order, set_count );
+    failures = 0;
+    phase_time( timed, &stats->timings.shuffle, &mark );
+    for( i = 0; i < set_count; i += step ) {
+      for( t = 0; t < job.threads; t++ ) {
+	job.workers[t].trained = 0;
+      }
+      run_step( &job, i, ( i + step < set_count ) ? i + step : set_count );
+      //the workers time their own phases; the caller's time in the step
+      //is theirs
+      if( timed ) {
+	mark = neural_clock();
+      }
+      trained = 0;
+      for( t = 0; t < job.threads; t++ ) {
+	w = job.workers + t;
+	trained += w->trained;
+	stats->training_count += w->trained;
+	if( w->trained && !( flags & TRAIN_HOGWILD ) ) {
+	  //an optimizer takes the step's changes as one sum
+	  apply_weights( ctx->optimizer.kind ? &ctx->batch_changes : weights,
+			 &w->changes );
+	  memset( (void *)w->changes.weights, 0,
+		  sizeof( double ) * w->changes.weight_count );
+	}
+      }
+      if( flags & TRAIN_HOGWILD ) {
+	stats->update_count += trained;
+      } else if( trained ) {
+	if( ctx->optimizer.kind ) {
+	  optimize_weights( &ctx->optimizer, weights, &ctx->batch_changes );
+	  memset( (void *)ctx->batch_changes.weights, 0,
+		  sizeof( double ) * ctx->batch_changes.weight_count );
+	}
+	stats->update_count++;
+      }
+      phase_time( timed, &stats->timings.apply, &mark );
+    }
+    for( t = 0; t < job.threads; t++ ) {
+      w = job.workers + t;
+      failures += w->failures;
+      stats->presentation_count += w->presentations;
+      stats->correct_count += w->correct;
+      w->failures = w->presentations = w->correct = 0;
+    }
+  }
+  gettimeofday( &stop_tv, (struct timezone *)NULL );
+  for( t = 0; t < job.threads; t++ ) {
+    w = job.workers + t;
+    add_feedback_stats( &stats->feedback, &w->state.feedback->stats );
+    stats->timings.forward += w->timings.forward;
+    stats->timings.backward += w->timings.backward;
+    stats->timings.apply += w->timings.apply;
+  }
+
+  job.done = 1;
+  barrier_wait( &job.barrier );
+  for( t = 1; t < job.threads; t++ ) {
+    pthread_join( job.workers[t].thread, NULL );
+  }
+  pthread_cond_destroy( &job.barrier.cond );
+  pthread_mutex_destroy( &job.barrier.lock );
+  free_workers( job.workers, threads );
+  stats->allocations = neural_allocation_count() - stats->allocations;
+  stats->work = training_work( def, stats );
+
+  stats->elapsed_seconds = (float)(stop_tv.tv_sec - start_tv.tv_sec) +
+    ((float)(stop_tv.tv_usec - start_tv.tv_usec))/1000000.0;
+  stats->correct_rate = (float)(stats->correct_count) /
+    (float)(stats->presentation_count);
+  stats->learned_count = set_count - failures;
+  stats->learned_fraction = (float)(stats->learned_count) /
+    (float)(set_count);
+  return 0;
+}
@@ -0,0 +1,299 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_context.h"
+#include "neural_telemetry.h"
+
+/* Lock-step training of several weight sets of one net (see net_replicas
+   and train_replicas_r() in neural.h).  Replicas go through the net's
+   _train_replicas a group of NET_REPLICA_LANES at a time; for nets without
+   one, replica_group_step() below does the same one replica at a time with
+   calc_net() and train_net(). */
+
+//the first weight of replica's group, and its lane in the group
+#define REPLICA_GROUP( r, replica ) \
+  ( (r)->weights + (size_t)( (replica) / NET_REPLICA_LANES ) * \
+    (r)->weight_count * NET_REPLICA_LANES )
+#define REPLICA_LANE( replica ) ( (replica) % NET_REPLICA_LANES )
+
+int init_net_replicas( net_definition *def, net_replicas *replicas,
+		       int count ) {
+  int groups = ( count + NET_REPLICA_LANES - 1 ) / NET_REPLICA_LANES;
+  char *fn = "init_net_replicas";
+
+  replicas->count = 0;
+  replicas->weight_count = def->info.weight_count;
+  if( count < 1 ) {
+    ERR_OUT( fn, "need at least one replica" );
+  }
+  replicas->weights = (double *)neural_calloc( (size_t)groups *
+					       def->info.weight_count *
+					       NET_REPLICA_LANES + 1,
+					       sizeof( double ) );
+  if( !replicas->weights ) {
+    ERRNO_OUT( fn, "Can't allocate replica weights" );
+  }
+  replicas->count = count;
+  return 0;
+}
+
+void free_net_replicas( net_replicas *replicas ) {
+  free( replicas->weights );
+  replicas->weights = NULL;
+  replicas->count = 0;
+}
+
+int get_replica_weights( net_definition *def, net_replicas *replicas,
+			 int replica, net_weights *weights ) {
+  double *group = REPLICA_GROUP( replicas, replica );
+  int w;
+
+  if( replica < 0 || replica >= replicas->count ) {
+    ERR_OUT( "get_replica_weights", "no such replica" );
+  }
+  if( weights->weight_count == 0 && 0 > init_net_weights( def, weights ) ) {
+    return -1;
+  }
+  for( w = 0; w < replicas->weight_count; w++ ) {
+    weights->weights[w] = group[w * NET_REPLICA_LANES + REPLICA_LANE( replica )];
+  }
+  return 0;
+}
+
+int set_replica_weights( net_replicas *replicas, int replica,
+			 net_weights *weights ) {
+  double *group = REPLICA_GROUP( replicas, replica );
+  int w;
+
+  if( replica < 0 || replica >= replicas->count ||
+      weights->weight_count != replicas->weight_count ) {
+    ERR_OUT( "set_replica_weights", "no such replica, or wrong weight count" );
+  }
+  for( w = 0; w < replicas->weight_count; w++ ) {
+    group[w * NET_REPLICA_LANES + REPLICA_LANE( replica )] = weights->weights[w];
+  }
+  return 0;
+}
+
+/* _train_replicas for nets which lack it: each active replica's weights
+   are copied out, and it is run and trained as train_on_set_r() does */
+static int replica_group_step( neural_context *ctx, net_definition *def,
+			       net_io *example, double *group,
+			       int active_replicas, int train_on_success,
+			       double training_level, net_weights *scratch ) {
+  net_io view = ctx->state;
+  int lane, w, right, right_replicas = 0;
+
+  for( lane = 0; lane < NET_REPLICA_LANES; lane++ ) {
+    if( !( active_replicas & ( 1 << lane ) ) ) {
+      continue;
+    }
+    for( w = 0; w < scratch->weight_count; w++ ) {
+      scratch->weights[w] = group[w * NET_REPLICA_LANES + lane];
+    }
+    view.inputs = example->inputs;
+    view.outputs = ctx->state.outputs;
+    calc_net( def, &view, scratch );
+    right = 0 < test_io_output( &view, example );
+    if( right ) {
+      right_replicas |= 1 << lane;
+    }
+    if( !right || train_on_success ) {
+      view.outputs = example->outputs;
+      train_net( def, &view, scratch, &ctx->weight_changes, training_level,
+		 NET_CORRECT_OUTPUTS_GIVEN | NET_APPLY_WEIGHT_CHANGES );
+      for( w = 0; w < scratch->weight_count; w++ ) {
+	group[w * NET_REPLICA_LANES + lane] = scratch->weights[w];
+      }
+    }
+  }
+  return right_replicas;
+}
+
+static double seconds_between( struct timeval *start, struct timeval *stop ) {
+  return (double)( stop->tv_sec - start->tv_sec ) +
+    (double)( stop->tv_usec - start->tv_usec ) / 1000000;
+}
+
+int train_replicas_r( neural_context *ctx, net_definition *def,
+		      net_io **training_set, int set_count,
+		      net_replicas *replicas,
+		      double training_level,
+		      double timeout_secs,
+		      training_statistics *stats,
+		      training_statistics *total,
+		      int flags ) {
+  struct timeval start_tv, cur_tv;
+  int groups = ( replicas->count + NET_REPLICA_LANES - 1 ) / NET_REPLICA_LANES;
+  int *active, *failures;
+  int train_on_success = ( flags & TRAIN_ON_SUCCESS ) ? 1 : 0;
+  int *order;
+  int i, g, lane, r, right, running;
+  net_weights scratch;
+  net_io *example;
+  double *group;
+  training_statistics *st;
+
+  memset( (void *)stats, 0, sizeof( training_statistics ) * replicas->count );
+  if( total ) {
+    memset( (void *)total, 0, sizeof( training_statistics ) );
+  }
+  memset( (void *)&scratch, 0, sizeof( net_weights ) );
+  if( TRAIN_OPTIMIZER_KIND( flags ) ) {
+    sprintf_neural_err( "train_replicas_r: replicas train without an "
+			"optimizer" );
+    context_error( ctx );
+    return -1;
+  }
+  if( 0 > context_scratch( ctx, def, set_count ) ||
+      0 > init_net_weights( def, &scratch ) ) {
+    context_error( ctx );
+    return -1;
+  }
+  //each group's active lanes, then each replica's failures; on the heap,
+  //as the replica count is the caller's
+  active = (int *)neural_calloc( groups + replicas->count, sizeof( int ) );
+  if( !active ) {
+    sprintf_neural_err( "train_replicas_r: can't allocate replica state" );
+    context_error( ctx );
+    free_net_weights( &scratch );
+    return -1;
+  }
+  failures = active + groups;
+  //starting weights, in the order separate runs would draw them
+  for( r = 0; r < replicas->count; r++ ) {
+    if( 0 > starting_weights_r( ctx, def, &scratch ) ) {
+      free_net_weights( &scratch );
+      free( active );
+      return -1;
+    }
+    set_replica_weights( replicas, r, &scratch );
+  }
+  start_feedback( &ctx->state, 0 );
+  order = ctx->order;
+  for( i = 0; i < set_count; i++ ) {
+    order[i] = i;
+  }
+  for( g = 0; g < groups; g++ ) {
+    active[g] = 0;
+    for( lane = 0; lane < NET_REPLICA_LANES; lane++ ) {
+      if( g * NET_REPLICA_LANES + lane < replicas->count ) {
+	active[g] |= 1 << lane;
+      }
+    }
+  }
+  for( r = 0; r < replicas->count; r++ ) {
+    failures[r] = 1;
+  }
+  running = replicas->count;
+
+  gettimeofday( &start_tv, (struct timezone *)NULL );
+
+  while( gettimeofday( &cur_tv, NULL ) == 0 &&
+	 timeout_secs > seconds_between( &start_tv, &cur_tv ) &&
+	 running > 0 ) {
+    //the same order train_on_set_r would take, shared by all
+    shuffle_order( ctx, order, set_count );
+    //only the running replicas start an iteration; one stopped by its
+    //budget keeps the failures of its last
+    for( r = 0; r < replicas->count; r++ ) {
+      if( active[r / NET_REPLICA_LANES] & ( 1 << REPLICA_LANE( r ) ) ) {
+	stats[r].iteration_count++;
+	failures[r] = 0;
+      }
+    }
+    for( i = 0; i < set_count; i++ ) {
+      example = training_set[order[i]];
+      for( g = 0; g < groups; g++ ) {
+	if( !active[g] ) {
+	  continue;
+	}
+	group = replicas->weights +
+	  (size_t)g * replicas->weight_count * NET_REPLICA_LANES;
+	if( def->train_replicas ) {
+	  right = def->train_replicas( example->inputs, example->input_count,
+				       example->outputs, example->output_count,
+				       group, replicas->weight_count,
+				       active[g], train_on_success,
+				       def->feedback_limit,
+				       def->feedback_convergence,
+				       training_level );
+	  if( right < 0 ) {
+	    sprintf_neural_err( "train_replicas_r: net rejected the example" );
+	    context_error( ctx );
+	    free_net_weights( &scratch );
+	    free( active );
+	    return -1;
+	  }
+	} else {
+	  right = replica_group_step( ctx, def, example, group, active[g],
+				      train_on_success, training_level,
+				      &scratch );
+	}
+	for( lane = 0; lane < NET_REPLICA_LANES; lane++ ) {
+	  if( !( active[g] & ( 1 << lane ) ) ) {
+	    continue;
+	  }
+	  st = stats + g * NET_REPLICA_LANES + lane;
+	  st->presentation_count++;
+	  if( right & ( 1 << lane ) ) {
+	    st->correct_count++;
+	  } else {
+	    failures[g * NET_REPLICA_LANES + lane]++;
+	  }
+	  if( !( right & ( 1 << lane ) ) || train_on_success ) {
+	    st->training_count++;
+	    st->update_count++;
+	  }
+	}
+      }
+    }
+    //a replica which got the whole iteration right, or used up its
+    //budget, is done
+    gettimeofday( &cur_tv, NULL );
+    for( r = 0; r < replicas->count; r++ ) {
+      g = r / NET_REPLICA_LANES;
+      if( ( failures[r] == 0 || !within_budget( ctx, def, stats + r ) ) &&
+	  ( active[g] & ( 1 << REPLICA_LANE( r ) ) ) ) {
+	active[g] &= ~( 1 << REPLICA_LANE( r ) );
+	stats[r].elapsed_seconds = seconds_between( &start_tv, &cur_tv );
+	running--;
+      }
+    }
+  }
+  gettimeofday( &cur_tv, NULL );
+  free_net_weights( &scratch );
+
+  for( r = 0; r < replicas->count; r++ ) {
+    st = stats + r;
+    if( active[r / NET_REPLICA_LANES] & ( 1 << REPLICA_LANE( r ) ) ) {
+      st->elapsed_seconds = seconds_between( &start_tv, &cur_tv );
+    }
+    st->correct_rate = (float)(st->correct_count) /
+      (float)(st->presentation_count);
+    st->learned_count = set_count - failures[r];
+    st->learned_fraction = (float)(st->learned_count) / (float)(set_count);
+    st->work = training_work( def, st );
+    if( total ) {
+      total->iteration_count += st->iteration_count;
+      total->presentation_count += st->presentation_count;
+      total->training_count += st->training_count;
+      total->correct_count += st->correct_count;
+      total->learned_count += st->learned_count;
+      total->update_count += st->update_count;
+      total->work += st->work;
+    }
+  }
+  free( active );
+  if( total ) {
+    total->elapsed_seconds = seconds_between( &start_tv, &cur_tv );
+    total->correct_rate = (float)(total->correct_count) /
+      (float)(total->presentation_count);
+    total->learned_fraction = (float)(total->learned_count) /
+      ( (float)set_count * replicas->count );
+  }
+  return 0;
+}
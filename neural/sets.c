@@ -4,89 +4,305 @@
 #include <sys/time.h>
 
 #include "neural.h"
+#include "neural_err.h"
+#include "neural_context.h"
+#include "neural_telemetry.h"
+#include "neural_stream.h"
 
-void train_on_set( net_definition *def, 
+void start_feedback( net_io *state, int flags ) {
+  net_feedback *feedback = state->feedback;
+
+  //a warm start begins from 0 too, so a seeded run repeats
+  memset( (void *)state->node_values, 0, sizeof( double ) * state->node_count );
+  memset( (void *)feedback->errors, 0, sizeof( double ) * feedback->node_count );
+  memset( (void *)&feedback->stats, 0, sizeof( net_feedback_stats ) );
+  feedback->flags = ( flags & TRAIN_WARM_FEEDBACK ) ?
+    NET_FEEDBACK_WARM_START : 0;
+}
+
+void train_on_set( net_definition *def,
 		   net_io **training_set, int set_count,
 		   net_weights *weights,
 		   double training_level,
 		   double timeout_secs,
 		   training_statistics *stats,
 		   int flags ) {
-  struct timeval start_tv, stop_tv, cur_tv;
-  net_io state;
-  net_weights weight_changes;
-  //these vars are used to visit the examples in random order each time.
-  unsigned char *visited;
-  int num_visited, cur_failure_count = 1;
-  int index;
-  int jump;
-  
-  int do_training = 0;
-
-  //zero training stats:
+  neural_context ctx;
+
+  init_neural_context( &ctx, neural_seed() );
+  train_on_set_r( &ctx, def, training_set, set_count, weights,
+		  training_level, timeout_secs, stats, flags );
+  free_neural_context( &ctx );
+}
+
+/* What train_on_set_r() and train_on_stream_r() do before the first
+   iteration: zeroes stats, and readies ctx's scratch (with room to order
+   order_count examples), optimizer (for set_count examples) and feedback
+   state and the starting weights. */
+static int start_training( neural_context *ctx, net_definition *def,
+			   net_weights *weights, double training_level,
+			   training_statistics *stats, int flags,
+			   int set_count, int order_count ) {
   memset( (void *)stats, 0, sizeof( training_statistics ) );
+  stats->allocations = neural_allocation_count();
+
+  if( 0 > context_scratch( ctx, def, order_count ) ) {
+    context_error( ctx );
+    return -1;
+  }
+  if( 0 > context_optimizer( ctx, def, flags, training_level,
+			     set_count ) ) {
+    context_error( ctx );
+    return -1;
+  }
+  if( 0 > starting_weights_r( ctx, def, weights ) ) {
+    return -1;
+  }
+  start_feedback( &ctx->state, flags );
+  if( ( flags >> TRAIN_BATCH_SHIFT ) > 1 ) {
+    memset( (void *)ctx->batch_changes.weights, 0,
+	    sizeof( double ) * ctx->batch_changes.weight_count );
+  }
+  return 0;
+}
+
+//true while a run started at start_tv has time and budget left and
+//examples still wrong
+static int keep_training( neural_context *ctx, net_definition *def,
+			  struct timeval *start_tv, double timeout_secs,
+			  training_statistics *stats, int failures ) {
+  struct timeval cur_tv;
+
+  return gettimeofday( &cur_tv, NULL ) == 0 &&
+    timeout_secs >
+    (double)( cur_tv.tv_sec - start_tv->tv_sec ) +
+    ( (double)( cur_tv.tv_usec - start_tv->tv_usec ) / 1000000 ) &&
+    failures > 0 && within_budget( ctx, def, stats );
+}
+
+/* Shows example to the net, and trains on it if it got it wrong (or
+   anyway, with TRAIN_ON_SUCCESS), either straight away or into the
+   mini-batch.  view is a copy of ctx's state, whose inputs and outputs are
+   pointed at the example's own.  Returns 1 if the net got it wrong. */
+static int present_example( neural_context *ctx, net_definition *def,
+			    net_io *view, net_io *example,
+			    net_weights *weights, double training_level,
+			    training_statistics *stats, int flags,
+			    int *batch_trained, double *mark ) {
+  int batch = flags >> TRAIN_BATCH_SHIFT;
+  int timed = flags & TRAIN_TIMINGS;
+  training_timings *timings = &stats->timings;
+  int wrong = 0, do_training = 0;
+
+  view->inputs = example->inputs;
+  view->outputs = ctx->state.outputs;
+  phase_time( timed, &timings->shuffle, mark );
+  calc_net( def, view, weights );
+  stats->presentation_count++;
+  if( 0 < test_io_output( view, example ) ) {
+    stats->correct_count++;
+    if( flags & TRAIN_ON_SUCCESS ) {
+      do_training = 1;
+    }
+  } else {
+    do_training = 1;
+    wrong = 1;
+  }
+  phase_time( timed, &timings->forward, mark );
+  if( do_training ) {
+    //the correct outputs for training are the example's own
+    view->outputs = example->outputs;
+    stats->training_count++;
+    if( batch > 1 ) {
+      accumulate_changes( def, view, weights, &ctx->weight_changes,
+			  &ctx->batch_changes, training_level,
+			  NET_CORRECT_OUTPUTS_GIVEN );
+      *batch_trained = 1;
+      phase_time( timed, &timings->backward, mark );
+    } else {
+      //the same as train_net() with NET_APPLY_WEIGHT_CHANGES, but
+      //timed separately
+      train_net( def, view, weights, &ctx->weight_changes, training_level,
+		 NET_CORRECT_OUTPUTS_GIVEN );
+      phase_time( timed, &timings->backward, mark );
+      optimize_weights( &ctx->optimizer, weights, &ctx->weight_changes );
+      phase_time( timed, &timings->apply, mark );
+      stats->update_count++;
+    }
+  }
+  return wrong;
+}
+
+//applies the mini-batch's summed changes, if it trained on anything
+static void end_batch( neural_context *ctx, net_weights *weights,
+		       training_statistics *stats, int flags,
+		       int *batch_trained, double *mark ) {
+  if( *batch_trained ) {
+    optimize_weights( &ctx->optimizer, weights, &ctx->batch_changes );
+    memset( (void *)ctx->batch_changes.weights, 0,
+	    sizeof( double ) * ctx->batch_changes.weight_count );
+    stats->update_count++;
+  }
+  *batch_trained = 0;
+  phase_time( flags & TRAIN_TIMINGS, &stats->timings.apply, mark );
+}
+
+//fills in the rest of stats once a run of set_count examples stops
+static void finish_training( neural_context *ctx, net_definition *def,
+			     struct timeval *start_tv,
+			     training_statistics *stats, int set_count,
+			     int failures ) {
+  struct timeval stop_tv;
+
+  gettimeofday( &stop_tv, (struct timezone *)NULL );
+  stats->feedback = ctx->state.feedback->stats;
+  stats->allocations = neural_allocation_count() - stats->allocations;
+  stats->work = training_work( def, stats );
+
+  stats->elapsed_seconds = (float)(stop_tv.tv_sec - start_tv->tv_sec) +
+    ((float)(stop_tv.tv_usec - start_tv->tv_usec))/1000000.0;
+  stats->correct_rate = (float)(stats->correct_count) /
+    (float)(stats->presentation_count);
+  stats->learned_count = set_count - failures;
+  stats->learned_fraction = (float)(stats->learned_count) /
+    (float)(set_count);
+}
+
+int train_on_set_r( neural_context *ctx, net_definition *def,
+		    net_io **training_set, int set_count,
+		    net_weights *weights,
+		    double training_level,
+		    double timeout_secs,
+		    training_statistics *stats,
+		    int flags ) {
+  struct timeval start_tv;
+  net_io view;
+  int *order;
+  int i, cur_failure_count = 1;
+  int batch = flags >> TRAIN_BATCH_SHIFT, in_batch = 0, batch_trained = 0;
+  double mark = 0;
+
+  if( 0 > start_training( ctx, def, weights, training_level, stats, flags,
+			  set_count, set_count ) ) {
+    return -1;
+  }
+  //start from the same order each run, so a seeded run repeats
+  order = ctx->order;
+  for( i = 0; i < set_count; i++ ) {
+    order[i] = i;
+  }
+  //calc_net() and train_net() read each example's own arrays in place;
+  //only the outputs and node values it computes go in the context's state
+  view = ctx->state;
 
-  init_net_weights( def, &weight_changes );
-  starting_weights( def, weights );
-  init_net_io( def, &state, 1 );
-  
   //start_tv is used to calculate more precicely how long it took:
   gettimeofday( &start_tv, (struct timezone *)NULL );
 
-  visited = malloc( sizeof(char) * set_count );
-  
-  srand( time(NULL) );
-
-  while( gettimeofday( &cur_tv, NULL ) == 0 &&
-	 timeout_secs > 
-	 (double)( cur_tv.tv_sec - start_tv.tv_sec ) +
-	 ( (double)( cur_tv.tv_usec - start_tv.tv_usec ) / 1000000 ) &&
-	 cur_failure_count > 0 ) {
+  while( keep_training( ctx, def, &start_tv, timeout_secs, stats,
+			cur_failure_count ) ) {
     stats->iteration_count++;
-    //this array keeps track of which items have been visited this iteration
-    memset( (void *)visited, 0, sizeof(char) * set_count );
+    if( flags & TRAIN_TIMINGS ) {
+      mark = neural_clock();
+    }
+    //visit the examples in a fresh random order each iteration
+    //(a shuffle of the previous order)
+    shuffle_order( ctx, order, set_count );
     cur_failure_count = 0;
-    for( num_visited = 0; num_visited < set_count; num_visited++ ) {
-      jump = rand() % (set_count - num_visited);
-      //count out the [jump]th unvisited item:
-      index = 0;
-      while( jump > 0 || visited[index] ) {
-	if( !visited[index] ) {
-	  jump--;
-	}
-	index++;
+    for( i = 0; i < set_count; i++ ) {
+      cur_failure_count +=
+	present_example( ctx, def, &view, training_set[order[i]], weights,
+			 training_level, stats, flags, &batch_trained, &mark );
+      //a batch ends after batch presentations, or with the iteration
+      if( batch > 1 && ( ++in_batch == batch || i == set_count - 1 ) ) {
+	end_batch( ctx, weights, stats, flags, &batch_trained, &mark );
+	in_batch = 0;
       }
-      visited[index] = 1;
-      copy_net_io( &state, training_set[index], COPY_INPUT );
-      calc_net( def, &state, weights );
-      stats->presentation_count++;
-      do_training = 0;
-      if( 0 < test_io_output( &state, training_set[index] ) ) {
-	stats->correct_count++;
-	if( flags & TRAIN_ON_SUCCESS ) {
-	  do_training = 1;
-	}
-      } else {
-	do_training = 1;
-	cur_failure_count++;
+    }
+  }
+  finish_training( ctx, def, &start_tv, stats, set_count, cur_failure_count );
+  return 0;
+}
+
+int train_on_stream_r( neural_context *ctx, net_definition *def,
+		       net_stream *stream,
+		       net_weights *weights,
+		       double training_level,
+		       double timeout_secs,
+		       training_statistics *stats,
+		       int flags ) {
+  struct timeval start_tv;
+  net_io view;
+  net_io_set *chunk;
+  int *order;
+  int i, last, cur_failure_count = 1;
+  //pass_failures counts the pass under way, which whole_pass says started
+  //at the top of the file; cur_failure_count is the last whole pass's
+  int in_pass = 0, whole_pass = 0, passed = 0, pass_failures = 0;
+  int batch = flags >> TRAIN_BATCH_SHIFT, in_batch = 0, batch_trained = 0;
+  double mark = 0;
+
+  //order is for one chunk at a time
+  if( 0 > start_training( ctx, def, weights, training_level, stats, flags,
+			  stream->count, stream->chunk_size ) ) {
+    return -1;
+  }
+  order = ctx->order;
+  view = ctx->state;
+  gettimeofday( &start_tv, (struct timezone *)NULL );
+
+  //the time and budgets are checked after every chunk, so a run may stop
+  //part way through a pass; the next run on the stream carries on from
+  //there, and counts that pass as an iteration, but not its failures
+  while( keep_training( ctx, def, &start_tv, timeout_secs, stats,
+			cur_failure_count ) ) {
+    if( !in_pass ) {
+      stats->iteration_count++;
+      whole_pass = stream->at_start;
+      pass_failures = 0;
+      in_pass = 1;
+    }
+    if( flags & TRAIN_TIMINGS ) {
+      mark = neural_clock();
+    }
+    chunk = next_stream_chunk( stream, &last );
+    if( !chunk ) {
+      context_error( ctx );
+      return -1;
+    }
+    //the chunk is the shuffle window: its examples in a random order,
+    //from the same start each time, so a seeded run repeats
+    for( i = 0; i < chunk->count; i++ ) {
+      order[i] = i;
+    }
+    shuffle_order( ctx, order, chunk->count );
+    for( i = 0; i < chunk->count; i++ ) {
+      pass_failures +=
+	present_example( ctx, def, &view, chunk->ptrs[order[i]], weights,
+			 training_level, stats, flags, &batch_trained,
+			 &mark );
+      //batches run across chunks, and end with the pass
+      if( batch > 1 &&
+	  ( ++in_batch == batch || ( last && i == chunk->count - 1 ) ) ) {
+	end_batch( ctx, weights, stats, flags, &batch_trained, &mark );
+	in_batch = 0;
       }
-      if( do_training ) {
-	copy_net_io( &state, training_set[index], COPY_OUTPUT );
-	train_net( def, &state, weights, &weight_changes, training_level, 
-		   NET_CORRECT_OUTPUTS_GIVEN | NET_APPLY_WEIGHT_CHANGES );
-	stats->training_count++;
+    }
+    if( last ) {
+      if( whole_pass ) {
+	cur_failure_count = pass_failures;
+	passed = 1;
       }
+      in_pass = 0;
     }
   }
-  gettimeofday( &stop_tv, (struct timezone *)NULL );
-  
-  stats->elapsed_seconds = (float)(stop_tv.tv_sec - start_tv.tv_sec) + 
-    ((float)(stop_tv.tv_usec - start_tv.tv_usec))/1000000.0;
-  stats->correct_rate = (float)(stats->correct_count) / 
-    (float)(stats->presentation_count);
-  stats->learned_count = set_count - cur_failure_count;
-  stats->learned_fraction = (float)(stats->learned_count) /
-    (float)(set_count);
+  //a run which stopped part way through a pass keeps its last batch
+  if( batch > 1 && in_batch ) {
+    end_batch( ctx, weights, stats, flags, &batch_trained, &mark );
+  }
+  //learned_count is from the last whole pass, and 0 without one
+  finish_training( ctx, def, &start_tv, stats, stream->count,
+		   passed ? cur_failure_count : stream->count );
+  return 0;
 }
 
 void test_on_set( net_definition *def,
@@ -94,34 +310,68 @@ void test_on_set( net_definition *def,
 		  net_weights *weights,
 		  test_statistics *stats,
 		  int flags ) {
-  net_io state;
+  neural_context ctx;
+
+  init_neural_context( &ctx, neural_seed() );
+  test_on_set_r( &ctx, def, test_set, set_count, weights, stats, flags );
+  free_neural_context( &ctx );
+}
+
+int test_on_set_r( neural_context *ctx, net_definition *def,
+		   net_io **test_set, int set_count,
+		   net_weights *weights,
+		   test_statistics *stats,
+		   int flags ) {
   int partial_success_count = 0;
   int partial_output_count = 0;
-  int i, test_result;
-  
-  init_net_io( def, &state, 1 );
+  int i, j, base, n, num_wrong;
+  int in_count = def->info.input_count, out_count = def->info.output_count;
+
   memset( (void *)stats, 0, sizeof( test_statistics ) );
-  
-  for( i=0; i<set_count; i++ ) {
-    copy_net_io( &state, test_set[i], COPY_INPUT );
-    calc_net( def, &state, weights );
-    test_result = test_io_output( &state, test_set[i] );
-    if( test_result > 0 ) {
-      stats->successful_items++;
-    } else {
-      partial_success_count += (-1)*test_result;
-      partial_output_count += state.output_count;
+  if( 0 > context_batch( ctx, def ) ) {
+    context_error( ctx );
+    return -1;
+  }
+
+  //the examples go through calc_net_batch() NEURAL_BATCH_SIZE at a time
+  for( base = 0; base < set_count; base += n ) {
+    n = set_count - base;
+    if( n > NEURAL_BATCH_SIZE ) {
+      n = NEURAL_BATCH_SIZE;
+    }
+    for( i = 0; i < n; i++ ) {
+      for( j = 0; j < in_count; j++ ) {
+	ctx->batch_inputs[j * n + i] = test_set[base + i]->inputs[j];
+      }
+    }
+    if( 0 > calc_net_batch( def, ctx->batch_inputs, ctx->batch_outputs,
+			    n, weights ) ) {
+      sprintf_neural_err( "test_on_set_r: net rejected the batch" );
+      context_error( ctx );
+      return -1;
+    }
+    //scored as test_io_output() would
+    for( i = 0; i < n; i++ ) {
+      num_wrong = 0;
+      for( j = 0; j < out_count; j++ ) {
+	if( ctx->batch_outputs[j * n + i] != test_set[base + i]->outputs[j] ) {
+	  num_wrong++;
+	}
+      }
+      if( num_wrong == 0 ) {
+	stats->successful_items++;
+      } else {
+	partial_success_count += out_count - num_wrong;
+	partial_output_count += out_count;
+      }
     }
   }
   stats->success_rate = (float)stats->successful_items / (float)set_count;
   if( stats->successful_items == set_count ) {
     stats->partial_success_avg = 0.0;
   } else {
-    stats->partial_success_avg = ((float)partial_success_count / 
+    stats->partial_success_avg = ((float)partial_success_count /
 				  (float)partial_output_count);
   }
+  return 0;
 }
-      
-      
-    
-  
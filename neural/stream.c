@@ -0,0 +1,221 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_telemetry.h"
+#include "neural_dataset.h"
+#include "neural_stream.h"
+
+/* Streamed training sets (see net_stream in neural.h).  The reader thread
+   runs ahead of training by one chunk: while the consumer works through
+   one buffer, the reader fills the other, and waits for the consumer to
+   give its buffer back before reading further. */
+
+//fills c with the reader's next chunk_size (or fewer) examples, going
+//back to the start of the set after the last
+static int read_chunk( net_stream *s, net_stream_chunk *c ) {
+  int i, n = s->count - s->next;
+  char *fn = "read_chunk";
+
+  if( n > s->chunk_size ) {
+    n = s->chunk_size;
+  }
+  c->set.count = n;
+  if( s->binary ) {
+    if( n && (size_t)n != fread( s->rows, s->row_bytes, n, s->file ) ) {
+      ERR_OUT( fn, "set file is truncated" );
+    }
+    unpack_rows( &c->set, s->rows, s->row_bytes );
+  } else {
+    for( i = 0; i < n; i++ ) {
+      if( 0 > fread_net_io( s->file, c->set.items + i ) ) {
+	//error already set by fread_net_io()
+	return -1;
+      }
+    }
+  }
+  s->next += n;
+  c->last = ( s->next == s->count );
+  if( c->last ) {
+    s->next = 0;
+    if( 0 > fseek( s->file, s->start, SEEK_SET ) ) {
+      ERRNO_OUT( fn, "can't go back to the start of the set" );
+    }
+  }
+  return 0;
+}
+
+static void *stream_reader_main( void *arg ) {
+  net_stream *s = (net_stream *)arg;
+  net_stream_chunk *c;
+
+  for( ;; ) {
+    pthread_mutex_lock( &s->lock );
+    c = s->chunks + s->reading;
+    while( c->filled && !s->done ) {
+      pthread_cond_wait( &s->cond, &s->lock );
+    }
+    if( s->done ) {
+      pthread_mutex_unlock( &s->lock );
+      break;
+    }
+    pthread_mutex_unlock( &s->lock );
+
+    if( 0 > read_chunk( s, c ) ) {
+      //neural_error() is this thread's; the consumer gets a copy
+      pthread_mutex_lock( &s->lock );
+      strncpy( s->errstr, neural_error(), NEURAL_ERRSTR_LEN - 1 );
+      s->failed = 1;
+      pthread_cond_broadcast( &s->cond );
+      pthread_mutex_unlock( &s->lock );
+      break;
+    }
+
+    pthread_mutex_lock( &s->lock );
+    c->filled = 1;
+    s->reading ^= 1;
+    pthread_cond_broadcast( &s->cond );
+    pthread_mutex_unlock( &s->lock );
+  }
+  return NULL;
+}
+
+net_io_set *next_stream_chunk( net_stream *s, int *last ) {
+  net_stream_chunk *c;
+
+  pthread_mutex_lock( &s->lock );
+  if( s->holding ) {
+    s->chunks[s->taking ^ 1].filled = 0;
+    s->holding = 0;
+    pthread_cond_broadcast( &s->cond );
+  }
+  c = s->chunks + s->taking;
+  while( !c->filled && !s->failed ) {
+    pthread_cond_wait( &s->cond, &s->lock );
+  }
+  if( !c->filled ) {
+    sprintf_neural_err( "%s", s->errstr );
+    pthread_mutex_unlock( &s->lock );
+    return NULL;
+  }
+  s->taking ^= 1;
+  s->holding = 1;
+  s->at_start = c->last;
+  pthread_mutex_unlock( &s->lock );
+  *last = c->last;
+  return &c->set;
+}
+
+//reads as far as the examples of the file's first set
+static int open_stream_file( net_stream *s, const char *fname,
+			     net_definition *def ) {
+  net_set_header h;
+  int count;
+  char *fn = "open_net_stream";
+
+  s->binary = is_binary_set( fname );
+  s->file = fopen( fname, "r" );
+  if( s->file == NULL ) {
+    sprintf_neural_err( "%s: can't open %s: %s", fn, fname, strerror( errno ) );
+    return -1;
+  }
+  if( !s->binary ) {
+    if( 1 != fscanf( s->file, "%d", &s->count ) || s->count < 0 ) {
+      ERR_OUT( fn, "can't read set count" );
+    }
+    s->start = ftell( s->file );
+    return 0;
+  }
+  if( 1 != fread( &h, sizeof( net_set_header ), 1, s->file ) ||
+      memcmp( h.magic, NET_SET_MAGIC, sizeof( h.magic ) ) ||
+      h.version != NET_SET_VERSION ) {
+    ERR_OUT( fn, "not a version 1 set file" );
+  }
+  if( h.input_count != def->info.input_count ||
+      h.output_count != def->info.output_count ) {
+    ERR_OUT( fn, "input/output counts don't match file" );
+  }
+  if( h.set_count < 1 ||
+      h.row_bytes != ( h.input_count + h.output_count + 7 ) / 8 ||
+      1 != fread( &count, sizeof( int ), 1, s->file ) || count < 0 ) {
+    ERR_OUT( fn, "set file header is inconsistent" );
+  }
+  s->count = count;
+  s->row_bytes = h.row_bytes;
+  s->start = sizeof( net_set_header ) + sizeof( int ) * h.set_count;
+  if( 0 > fseek( s->file, s->start, SEEK_SET ) ) {
+    ERRNO_OUT( fn, "can't find the examples" );
+  }
+  return 0;
+}
+
+static void free_stream( net_stream *s ) {
+  if( s->file ) {
+    fclose( s->file );
+  }
+  free( s->rows );
+  free_io_set( &s->chunks[0].set );
+  free_io_set( &s->chunks[1].set );
+  free( s );
+}
+
+int open_net_stream( const char *fname, net_definition *def, int chunk_size,
+		     net_stream **stream ) {
+  net_stream *s;
+  char *fn = "open_net_stream";
+
+  *stream = NULL;
+  if( chunk_size < 1 ) {
+    ERR_OUT( fn, "chunk_size must be at least 1" );
+  }
+  s = (net_stream *)neural_calloc( 1, sizeof( net_stream ) );
+  if( !s ) {
+    ERRNO_OUT( fn, "Can't allocate stream" );
+  }
+  s->chunk_size = chunk_size;
+  s->at_start = 1;
+  if( 0 > open_stream_file( s, fname, def ) ||
+      0 > init_io_set( &s->chunks[0].set, chunk_size, def, 0 ) ||
+      0 > init_io_set( &s->chunks[1].set, chunk_size, def, 0 ) ) {
+    free_stream( s );
+    return -1;
+  }
+  if( s->binary ) {
+    s->rows = (unsigned char *)neural_malloc( (size_t)chunk_size *
+					      s->row_bytes + 1 );
+    if( !s->rows ) {
+      free_stream( s );
+      ERRNO_OUT( fn, "Can't allocate row buffer" );
+    }
+  }
+  pthread_mutex_init( &s->lock, NULL );
+  pthread_cond_init( &s->cond, NULL );
+  //the first chunk is on its way before this returns
+  if( pthread_create( &s->thread, NULL, stream_reader_main, s ) ) {
+    pthread_cond_destroy( &s->cond );
+    pthread_mutex_destroy( &s->lock );
+    free_stream( s );
+    ERR_OUT( fn, "can't start the reader thread" );
+  }
+  *stream = s;
+  return 0;
+}
+
+void close_net_stream( net_stream *s ) {
+  pthread_mutex_lock( &s->lock );
+  s->done = 1;
+  pthread_cond_broadcast( &s->cond );
+  pthread_mutex_unlock( &s->lock );
+  pthread_join( s->thread, NULL );
+  pthread_cond_destroy( &s->cond );
+  pthread_mutex_destroy( &s->lock );
+  free_stream( s );
+}
+
+int net_stream_count( net_stream *s ) {
+  return s->count;
+}
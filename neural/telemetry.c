@@ -0,0 +1,123 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_telemetry.h"
+
+static __thread int allocation_count;
+
+double neural_clock() {
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void *neural_malloc( size_t size ) {
+  allocation_count++;
+  return malloc( size );
+}
+
+void *neural_calloc( size_t count, size_t size ) {
+  allocation_count++;
+  return calloc( count, size );
+}
+
+int neural_allocation_count() {
+  return allocation_count;
+}
+
+//writes str as a JSON string
+static void fwrite_json_string( FILE *file, const char *str ) {
+  fputc( '"', file );
+  for( ; *str; str++ ) {
+    if( *str == '"' || *str == '\\' ) {
+      fprintf( file, "\\%c", *str );
+    } else if( (unsigned char)*str < 0x20 ) {
+      fprintf( file, "\\u%04x", (unsigned char)*str );
+    } else {
+      fputc( *str, file );
+    }
+  }
+  fputc( '"', file );
+}
+
+static void fwrite_json_longs( FILE *file, const char *name,
+			       long *values, int count ) {
+  int i;
+
+  fprintf( file, "\"%s\":[", name );
+  for( i = 0; i < count; i++ ) {
+    fprintf( file, "%s%ld", i ? "," : "", values[i] );
+  }
+  fprintf( file, "]" );
+}
+
+//JSON has no NaN (correct_rate after no presentations, say)
+static double json_number( double value ) {
+  return isfinite( value ) ? value : 0.0;
+}
+
+int fwrite_statistics_json( FILE *file, const char *net_name,
+			    net_definition *def,
+			    training_statistics *train,
+			    test_statistics *test ) {
+  struct net_info *info = &def->info;
+  training_timings *t = &train->timings;
+  int groups = info->feedback_groups < NET_FEEDBACK_STATS ?
+    info->feedback_groups : NET_FEEDBACK_STATS;
+  double other;
+
+  fprintf( file, "{\"net\":" );
+  fwrite_json_string( file, net_name ? net_name : "" );
+  fprintf( file, ",\"info\":{\"input_count\":%d,\"output_count\":%d,"
+	   "\"weight_count\":%d,\"node_count\":%d,\"variant\":%d,"
+	   "\"feedback_groups\":%d,\"feedback_limit\":%d,"
+	   "\"feedback_convergence\":%.17g}",
+	   info->input_count, info->output_count, info->weight_count,
+	   info->node_count, info->variant, info->feedback_groups,
+	   def->feedback_limit, def->feedback_convergence );
+
+  fprintf( file, ",\"training_statistics\":{\"iteration_count\":%d,"
+	   "\"presentation_count\":%d,\"training_count\":%d,"
+	   "\"correct_count\":%d,\"learned_count\":%d,"
+	   "\"elapsed_seconds\":%.9g,\"correct_rate\":%.9g,"
+	   "\"learned_fraction\":%.9g,\"update_count\":%d,\"work\":%.17g,"
+	   "\"presentations_per_second\":%.9g,\"allocations\":%d",
+	   train->iteration_count, train->presentation_count,
+	   train->training_count, train->correct_count, train->learned_count,
+	   train->elapsed_seconds, json_number( train->correct_rate ),
+	   json_number( train->learned_fraction ),
+	   train->update_count, train->work,
+	   train->elapsed_seconds > 0 ?
+	   train->presentation_count / train->elapsed_seconds : 0.0,
+	   train->allocations );
+  //whatever the phases don't account for (the loop, timing itself); only
+  //known if the run was timed
+  other = train->elapsed_seconds - t->forward - t->backward - t->apply -
+    t->shuffle;
+  fprintf( file, ",\"timings\":{\"forward\":%.9g,\"backward\":%.9g,"
+	   "\"apply\":%.9g,\"shuffle\":%.9g,\"other\":%.9g}",
+	   t->forward, t->backward, t->apply, t->shuffle,
+	   ( t->forward > 0 && other > 0 ) ? other : 0.0 );
+  fprintf( file, ",\"feedback\":{" );
+  fwrite_json_longs( file, "sweeps", train->feedback.sweeps, groups );
+  fprintf( file, "," );
+  fwrite_json_longs( file, "error_sweeps", train->feedback.error_sweeps,
+		     groups );
+  fprintf( file, ",\"unsettled\":%ld}}", train->feedback.unsettled );
+
+  if( test ) {
+    fprintf( file, ",\"test_statistics\":{\"successful_items\":%d,"
+	     "\"success_rate\":%.9g,\"partial_success_avg\":%.9g}",
+	     test->successful_items, json_number( test->success_rate ),
+	     json_number( test->partial_success_avg ) );
+  }
+  fprintf( file, "}\n" );
+  if( ferror( file ) ) {
+    ERRNO_OUT( "fwrite_statistics_json", "can't write statistics" );
+  }
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "neural.h"
+#include "neural_err.h"
+#include "neural_file.h"
+#include "neural_weights.h"
+
+int is_weights_checkpoint( const char *fname ) {
+  return file_has_magic( fname, NET_WEIGHTS_MAGIC );
+}
+
+int save_weights( const char *fname, net_definition *def,
+		  net_weights *weights ) {
+  net_weights_header h;
+  FILE *file;
+  char tmp[strlen( fname ) + 32];
+  char *fn = "save_weights";
+
+  if( weights->weight_count != def->info.weight_count ) {
+    ERR_OUT( fn, "weight_count doesn't match the net" );
+  }
+  memset( (void *)&h, 0, sizeof( net_weights_header ) );
+  memcpy( h.magic, NET_WEIGHTS_MAGIC, sizeof( h.magic ) );
+  h.version = NET_WEIGHTS_VERSION;
+  h.input_count = def->info.input_count;
+  h.output_count = def->info.output_count;
+  h.weight_count = def->info.weight_count;
+  h.node_count = def->info.node_count;
+  h.variant = def->info.variant;
+  h.checksum = file_checksum( weights->weights,
+			      sizeof( double ) * weights->weight_count );
+
+  //written under a temp name, so a reader never sees half a checkpoint
+  sprintf( tmp, "%s.%d.tmp", fname, (int)getpid() );
+  file = fopen( tmp, "w" );
+  if( file == NULL ) {
+    sprintf_neural_err( "%s: can't open %s: %s", fn, tmp, strerror( errno ) );
+    return -1;
+  }
+  if( 1 != fwrite( &h, sizeof( net_weights_header ), 1, file ) ||
+      weights->weight_count !=
+      fwrite( weights->weights, sizeof( double ), weights->weight_count, file ) ||
+      0 != fclose( file ) ) {
+    sprintf_neural_err( "%s: can't write %s: %s", fn, tmp, strerror( errno ) );
+    unlink( tmp );
+    return -1;
+  }
+  if( 0 > rename( tmp, fname ) ) {
+    sprintf_neural_err( "%s: can't rename %s to %s: %s", fn, tmp, fname,
+			strerror( errno ) );
+    unlink( tmp );
+    return -1;
+  }
+  return 0;
+}
+
+int load_weights( const char *fname, net_definition *def,
+		  net_weights *weights ) {
+  void *map;
+  size_t size;
+  const net_weights_header *h;
+  char *fn = "load_weights";
+
+  if( 0 > map_file( fn, fname, &map, &size ) ) {
+    return -1;
+  }
+  h = (const net_weights_header *)map;
+  if( size < sizeof( net_weights_header ) ||
+      memcmp( h->magic, NET_WEIGHTS_MAGIC, sizeof( h->magic ) ) ||
+      h->version != NET_WEIGHTS_VERSION ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "not a version 1 weights checkpoint" );
+  }
+  if( h->input_count != def->info.input_count ||
+      h->output_count != def->info.output_count ||
+      h->weight_count != def->info.weight_count ||
+      h->node_count != def->info.node_count ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "checkpoint is for a different net" );
+  }
+  if( size != sizeof( net_weights_header ) + sizeof( double ) * h->weight_count ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "checkpoint is truncated" );
+  }
+  if( file_checksum( h + 1, sizeof( double ) * h->weight_count ) != h->checksum ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "checkpoint checksum mismatch" );
+  }
+
+  if( weights->weight_count == 0 && 0 > init_net_weights( def, weights ) ) {
+    unmap_file( map, size );
+    return -1;
+  }
+  if( weights->weight_count != h->weight_count ) {
+    unmap_file( map, size );
+    ERR_OUT( fn, "weight_count in struct != weight_count in checkpoint" );
+  }
+  memcpy( weights->weights, h + 1, sizeof( double ) * h->weight_count );
+  unmap_file( map, size );
+  return 0;
+}
@@ -24,9 +24,13 @@ Evolver implements a genetic algorithm in a generic form.  All particulars of ge
 package Evolver;
 
 use Storable qw(nstore_fd);
+use File::Copy qw(copy);
+use File::Path qw(rmtree);
 use Time::HiRes qw(gettimeofday);
 use Digest::MD5 qw(md5_base64);
 use POSIX qw(strftime uname);
+use IO::Handle;
+use IO::Select;
 
 use Errorable;
 use Utility qw(progress_dots);
@@ -57,7 +61,9 @@ sub _init {
     if( defined $args{project} ) {
       my $def = ProjectConfig::get_config( $args{project} );
       #populate the hash with optional fields:
-      my @optional = qw(average_over rm_killed);
+      my @optional = qw(average_over rm_killed fitness_workers racing
+			migration_dir migration_interval migration_count
+			island);
       for my $fld (@optional) {
 	unless( exists $def->{$fld} ) {
 	  $def->{$fld} = undef;
@@ -74,13 +80,10 @@ sub _init {
 	$self->_set_generation( 0 );
 	my @pop = $self->get_starting_population( $self->dir() );
 	print "Saving start population";
-	my $ndone = 0;
-	for my $indiv (@pop) {
-	  my $id = make_identifier();
-	  $indiv->save( $self->dir(), $id );
+	my @new = map { ( make_identifier(), $_ ) } @pop;
+	$self->_save_individuals( @new );
+	while( my( $id, $indiv ) = splice( @new, 0, 2 ) ) {
 	  $self->add_individual( $id, $indiv );
-	  $ndone++;
-	  progress_dots( 50, $ndone, (@pop + 0) );
 	}
 	print "done\n";
       }
@@ -119,6 +122,34 @@ sub add_individual {
   return $self->{POPULATION}->{$id};
 }
 
+#saves ( <id> => <individual>, ... ) in the project dir, a class at a time
+#with the class's save_population() if it has one
+sub _save_individuals {
+  my $self = shift;
+  $self->_save_individuals_in( $self->dir(), @_ );
+}
+
+sub _save_individuals_in {
+  my $self = shift;
+  my $dir = shift;
+  my @new = @_;
+  my( %by_class, @classes );
+  while( my( $id, $ind ) = splice( @new, 0, 2 ) ) {
+    push @classes, ref( $ind ) unless $by_class{ref( $ind )};
+    push @{$by_class{ref( $ind )}}, $id, $ind;
+  }
+  for my $class (@classes) {
+    my @pairs = @{$by_class{$class}};
+    if( $class->can( 'save_population' ) ) {
+      $class->save_population( $dir, @pairs );
+    } else {
+      while( my( $id, $ind ) = splice( @pairs, 0, 2 ) ) {
+	$ind->save( $dir, $id );
+      }
+    }
+  }
+}
+
 sub get_individual {
   my $self = shift;
   my $id = shift;
@@ -179,31 +210,29 @@ sub run_generation {
   my $new_min_fit = 100000000;
   my @popdata;
 
-  my @pop = $self->all_individuals();
+  #fixed order, so results don't depend on hash ordering or on workers
+  my @pop = sort( { $a->{ID} cmp $b->{ID} } $self->all_individuals() );
+  my $avg_over = $self->average_over();
+  $avg_over = 1 unless defined $avg_over;
   print "Calculating fitness";
-  for my $individual (@pop) {
-    my $n = 1;
-    my $avg_over = $self->average_over();
-    $avg_over = 1 unless defined $avg_over;
-    unless( defined $individual->{FITNESS} ) {
-      $n = $avg_over;
-    }
-    my $tot = 0;
-    #print "->>$avg_over / $n\n";
-    for my $i (1..$n) {
-      $tot += $individual->{OBJECT}->test_fitness();
-    }
-    my $curr = $tot/$n;
-    #print "cur: $tot / $n = $curr\n";
-    if( defined $individual->{FITNESS} ) {
-      #print "prefit: $individual->{FITNESS}\n";
-      my $nsamp = $avg_over + $individual->{AGE};
-      $individual->{FITNESS} = ( ($curr/$nsamp + $individual->{FITNESS}) *
-				 ($nsamp/($nsamp + 1)) );
-      #print "fit: $curr, $avg_over --> $individual->{FITNESS}\n";
-    } else {
-      $individual->{FITNESS} = $curr;
+  $self->{_PREPARED} = {};
+  my $nsamples;
+  if( $self->racing() ) {
+    $nsamples = $self->_race_fitness( $avg_over, @pop );
+  } else {
+    #one job per fitness sample needed; new individuals get $avg_over of them
+    my @jobs;
+    for my $individual (@pop) {
+      my $n = 1;
+      unless( defined $individual->{FITNESS} ) {
+	$n = $avg_over;
+      }
+      push @jobs, ( $individual ) x $n;
     }
+    $self->_add_samples( \@jobs, 1 );
+    $nsamples = @jobs + 0;
+  }
+  for my $individual (@pop) {
     $tot_fitness += $individual->{FITNESS};
     $nfit++;
     $tot_age += $individual->{AGE};
@@ -233,11 +262,14 @@ sub run_generation {
     if( $min_fit > $individual->{FITNESS} ) {
       $min_fit = $individual->{FITNESS};
     }
-    progress_dots( 50, $nfit, (@pop + 1) );
     $individual->{AGE}++;
   }
-  print "done\n";
+  print "done ($nsamples samples)\n";
   @pop = sort( { $a->{FITNESS} <=> $b->{FITNESS} } @pop );
+  my( $nemigrants, $nimmigrants ) = ( 0, 0 );
+  if( $self->migration_dir() ) {
+    ( $nemigrants, $nimmigrants ) = $self->_migrate( \@pop );
+  }
   my $avg_fitness = $tot_fitness/$nfit;
   my $avg_ret_fitness = 0;
   if( $nretained ) {
@@ -252,10 +284,12 @@ sub run_generation {
   #get the ones to kill:
   my @hit_list = $self->kill( @pop );
   my $nkill = @hit_list + 0;
+  $self->{TURNOVER} = $nkill;
   my $ppi = $self->parents_per_individual();
   my $nparents = ($ppi > $nkill)?$ppi:$nkill;
   my @parent_pool = $self->select( $nparents, @pop );
   my $nkids = $nkill;
+  my @kids;
   print "Generating new individuals";
   while( $nkids ) {
     #take the next 'primary parent'
@@ -271,12 +305,15 @@ sub run_generation {
     }
     my $kid = $primary->{OBJECT}->breed( $self->mutation_level(), 
 					 (map {$_->{OBJECT}} @secondaries) );
-    my $id = make_identifier();
-    $kid->save( $self->dir(), $id );
-    $self->add_individual( $id, $kid );
+    push @kids, make_identifier(), $kid;
     $nkids--;
     progress_dots( 50, $nkill - $nkids, $nkill );
   }
+  #the whole generation is saved at once
+  $self->_save_individuals( @kids );
+  while( my( $id, $kid ) = splice( @kids, 0, 2 ) ) {
+    $self->add_individual( $id, $kid );
+  }
   print "done\n";
   #kill off the deselected:
   for my $hit (@hit_list) {
@@ -292,6 +329,9 @@ sub run_generation {
 		 population => (@pop + 0),
 		 popdata => \@popdata,
 		 turnover => $nkill,
+		 fitness_samples => $nsamples,
+		 emigrants => $nemigrants,
+		 immigrants => $nimmigrants,
 		 avg_fitness => $avg_fitness,
 		 ret_avg_fitness => $avg_ret_fitness,
 		 ret_max_fit => $ret_max_fit,
@@ -306,6 +346,383 @@ sub run_generation {
   }
 }
 
+#this island's name in migration_dir
+sub _island_name {
+  my $self = shift;
+  my $name = $self->island();
+  unless( defined $name ) {
+    my $dir = $self->dir();
+    $dir =~ s{/+$}{};
+    $dir =~ s{.*/}{};
+    $name = ( uname() )[1] . "_$dir";
+  }
+  $name =~ tr{/}{_};
+  return $name;
+}
+
+#island mode (see L</migration_dir>): every migration_interval
+#generations, sends copies of the best migration_count individuals of
+#@$pop (sorted by ascending FITNESS) to migration_dir, and takes in those
+#the other islands have sent since last time, in place of the worst.
+#@$pop is updated, and kept sorted.  Returns the number sent and the
+#number taken in.
+sub _migrate {
+  my $self = shift;
+  my $pop = shift;
+
+  my $interval = $self->migration_interval() || 5;
+  return ( 0, 0 ) if $self->generation_count() % $interval;
+  my $count = $self->migration_count();
+  $count = 2 unless defined $count;
+  my $root = $self->migration_dir();
+  my $island = $self->_island_name();
+  my $gen = $self->generation_count();
+  my $outbox = "$root/$island";
+  unless( -d $outbox ) {
+    mkdir $root;
+    mkdir $outbox or die "Can't create $outbox: $!";
+  }
+
+  #emigrants: fresh copies of the best, saved as a little project of
+  #their own, which appears all at once when the temp dir is renamed
+  my @best = reverse( @$pop[( @$pop > $count ? @$pop - $count : 0 )..$#$pop] );
+  my $tmp = "$outbox/.tmp.$gen.$$";
+  rmtree( $tmp );
+  mkdir $tmp or die "Can't create $tmp: $!";
+  #individuals may need the config to save or load themselves
+  copy( $self->dir() . "/config", "$tmp/config" )
+    or die "Can't copy config to $tmp: $!";
+  my @sent;
+  for my $ind (@best) {
+    my $copy = $self->load_individual( $self->dir(), $ind->{ID} );
+    push @sent, $ind->{ID}, $copy;
+  }
+  $self->_save_individuals_in( $tmp, @sent );
+  Storable::nstore( [ map { { ID => $_->{ID}, FITNESS => $_->{FITNESS},
+			      SAMPLES => $_->{SAMPLES}, SUM_SQ => $_->{SUM_SQ},
+			      AGE => $_->{AGE} } } @best ],
+		    "$tmp/migrants" );
+  rmtree( "$outbox/$gen" );
+  rename( $tmp, "$outbox/$gen" ) or die "Can't rename $tmp: $!";
+  #a few generations' worth is enough for slower islands to catch up
+  opendir( OUT, $outbox ) or die "Can't read $outbox: $!";
+  my @old = sort( { $b <=> $a } grep { /^\d+$/ } readdir( OUT ) );
+  closedir( OUT );
+  rmtree( "$outbox/$_" ) for @old[4..$#old];
+
+  #immigrants: everything sent by the others since we last looked, up to
+  #half the population
+  my $seen = $self->{MIGRATION_SEEN} ||= {};
+  my %present = map { $_->{ID} => 1 } @$pop;
+  my @arrivals;
+  opendir( ROOT, $root ) or die "Can't read $root: $!";
+  my @islands = sort( grep { !/^\./ and $_ ne $island and -d "$root/$_" }
+		      readdir( ROOT ) );
+  closedir( ROOT );
+  for my $other (@islands) {
+    opendir( IN, "$root/$other" ) or next;
+    my @packets = sort( { $a <=> $b } grep { /^\d+$/ } readdir( IN ) );
+    closedir( IN );
+    for my $packet (@packets) {
+      next if defined $seen->{$other} and $packet <= $seen->{$other};
+      my $dir = "$root/$other/$packet";
+      my $migrants = eval { Storable::retrieve( "$dir/migrants" ) };
+      #the sender may have removed it meanwhile
+      next unless defined $migrants;
+      for my $m (@$migrants) {
+	next if $present{$m->{ID}}++;
+	my $obj = eval { $self->load_individual( $dir, $m->{ID} ) };
+	next unless defined $obj;
+	push @arrivals, [ $m, $obj ];
+      }
+      $seen->{$other} = $packet;
+    }
+  }
+  my $room = int( @$pop / 2 );
+  splice( @arrivals, $room ) if @arrivals > $room;
+  return ( @best + 0, 0 ) unless @arrivals;
+  $self->_save_individuals( map { ( $_->[0]->{ID}, $_->[1] ) } @arrivals );
+  #they take the places of the worst
+  for my $worst (splice( @$pop, 0, @arrivals + 0 )) {
+    $self->remove_individual( $worst->{ID} );
+  }
+  for my $arrival (@arrivals) {
+    my( $m, $obj ) = @$arrival;
+    my $ind = $self->add_individual( $m->{ID}, $obj );
+    $ind->{$_} = $m->{$_} for grep { defined $m->{$_} } keys( %$m );
+    push @$pop, $ind;
+  }
+  @$pop = sort( { $a->{FITNESS} <=> $b->{FITNESS} } @$pop );
+  return ( @best + 0, @arrivals + 0 );
+}
+
+#samples the fitness of each entry of @$jobs (population entries, which
+#may repeat), and folds the results into their FITNESS, the mean of all
+#their samples so far.
+sub _add_samples {
+  my $self = shift;
+  my( $jobs, $show_progress ) = @_;
+
+  my @scores = $self->_sample_fitness( $show_progress, @$jobs );
+  my %samples;
+  for my $i (0..$#$jobs) {
+    push @{$samples{$jobs->[$i]->{ID}}}, $scores[$i];
+  }
+  my %seen;
+  for my $individual (grep { not $seen{$_->{ID}}++ } @$jobs) {
+    my @samp = @{$samples{$individual->{ID}}};
+    my( $tot, $sq ) = ( 0, 0 );
+    for my $score (@samp) {
+      $tot += $score;
+      $sq += $score * $score;
+    }
+    if( defined $individual->{FITNESS} ) {
+      my $nsamp = $individual->{SAMPLES};
+      $individual->{FITNESS} = ( $individual->{FITNESS} * $nsamp + $tot ) /
+	( $nsamp + @samp );
+      $individual->{SAMPLES} = $nsamp + @samp;
+      #the spread is only known if every sample was seen
+      $individual->{SUM_SQ} += $sq if defined $individual->{SUM_SQ};
+    } else {
+      $individual->{FITNESS} = $tot / @samp;
+      $individual->{SAMPLES} = @samp + 0;
+      $individual->{SUM_SQ} = $sq;
+    }
+  }
+}
+
+#racing (see L</racing>): samples fitness in rounds, each of which gives
+#one more sample to every individual which might still be on either side
+#of the kill or the selection boundary; new individuals get up to
+#$avg_over samples, the rest one a generation.  Returns the number of
+#samples taken.
+sub _race_fitness {
+  my $self = shift;
+  my $avg_over = shift;
+  my @pop = @_;
+
+  my $z = $self->racing();
+  my %limit = map { $_->{ID} => ( defined $_->{FITNESS} ? 1 : $avg_over ) }
+    @pop;
+  my %taken;
+  #everything new needs a first sample to be placed at all
+  my @round = grep { not defined $_->{FITNESS} } @pop;
+  my $nsamples = 0;
+  my $show_progress = 1;
+  for( ;; ) {
+    if( @round ) {
+      $self->_add_samples( \@round, $show_progress );
+      $show_progress = 0;
+      print ".";
+      $nsamples += @round;
+      $taken{$_->{ID}}++ for @round;
+    }
+
+    my @bounds = $self->_race_boundaries( @pop );
+    my $sigma = _pooled_deviation( @pop );
+    @round = ();
+    for my $individual (@pop) {
+      next if ( $taken{$individual->{ID}} || 0 ) >= $limit{$individual->{ID}};
+      #without a spread to go on, nothing is clear yet
+      if( defined $sigma ) {
+	my $margin = $z * $sigma / sqrt( $individual->{SAMPLES} );
+	next unless grep { abs( $individual->{FITNESS} - $_ ) <= $margin }
+	  @bounds;
+      }
+      push @round, $individual;
+    }
+    last unless @round;
+  }
+  return $nsamples;
+}
+
+#the fitness values between those which would be killed and the rest, and
+#between those which would be selected to breed and the rest, on the
+#current estimates; the number killed is taken from the last generation
+sub _race_boundaries {
+  my $self = shift;
+  my @pop = sort( { $a->{FITNESS} <=> $b->{FITNESS} } @_ );
+
+  my $nkill = $self->{TURNOVER};
+  unless( defined $nkill ) {
+    my @hits = $self->kill( @pop );
+    $nkill = @hits + 0;
+  }
+  my $ppi = $self->parents_per_individual();
+  my $nparents = ( $ppi > $nkill ) ? $ppi : $nkill;
+  my @bounds;
+  for my $rank ($nkill, @pop - $nparents) {
+    next unless $rank > 0 and $rank < @pop;
+    push @bounds, ( $pop[$rank - 1]->{FITNESS} + $pop[$rank]->{FITNESS} ) / 2;
+  }
+  return @bounds;
+}
+
+#the standard deviation of one fitness sample, pooled over the individuals
+#with more than one; undef if there are none
+sub _pooled_deviation {
+  my( $ss, $df ) = ( 0, 0 );
+  for my $individual (@_) {
+    my $n = $individual->{SAMPLES};
+    next unless $n > 1 and defined $individual->{SUM_SQ};
+    $ss += $individual->{SUM_SQ} - $n * $individual->{FITNESS} ** 2;
+    $df += $n - 1;
+  }
+  return undef unless $df;
+  return sqrt( $ss > 0 ? $ss / $df : 0 );
+}
+
+#returns one test_fitness() result per entry of @jobs (population entries,
+#which may repeat), in the same order.  Individuals are handed to their
+#class's prepare_population(), and those which can prepare_fitness() are
+#prepared once a generation, before any of their samples are taken,
+#so that concurrent samples of one individual don't race to set it up.
+sub _sample_fitness {
+  my $self = shift;
+  my $show_progress = shift;
+  my @jobs = @_;
+
+  my %seen = %{$self->{_PREPARED}};
+  my @unique = grep { not $seen{$_->{ID}}++ } @jobs;
+  $self->{_PREPARED}->{$_->{ID}} = 1 for @unique;
+  #classes which can set up many individuals at once go first
+  my %by_class;
+  for my $ind (@unique) {
+    push @{$by_class{ref( $ind->{OBJECT} )}}, $ind->{OBJECT};
+  }
+  for my $class (sort( keys( %by_class ) )) {
+    if( $class->can( 'prepare_population' ) ) {
+      $class->prepare_population( @{$by_class{$class}} );
+    }
+  }
+  my @prep = grep { $_->{OBJECT}->can( 'prepare_fitness' ) } @unique;
+  $self->_parallel_map( sub { $_[0]->{OBJECT}->prepare_fitness(); return 1; },
+			0, @prep );
+  return $self->_parallel_map( sub { $_[0]->{OBJECT}->test_fitness() },
+			       $show_progress, @jobs );
+}
+
+#calls &$fn( $job ) for each job (population entries), using up to
+#fitness_workers forked processes, and returns the (numeric) results in
+#the order of @jobs.  Each worker is handed the index of its next job as
+#soon as it reports the previous one, so slow jobs don't hold up the rest
+#of the pool.  What the workers need to keep between calls, such as
+#fitness servers, their classes' prepare_workers() sets up beforehand.
+sub _parallel_map {
+  my $self = shift;
+  my $fn = shift;
+  my $show_progress = shift;
+  my @jobs = @_;
+  my @results;
+
+  my $nworkers = $self->fitness_workers();
+  $nworkers = 1 unless defined $nworkers;
+  if( $nworkers > @jobs ) {
+    $nworkers = @jobs + 0;
+  }
+  if( $nworkers <= 1 ) {
+    for my $i (0..$#jobs) {
+      $results[$i] = &$fn( $jobs[$i] );
+      progress_dots( 50, $i + 1, (@jobs + 0) ) if $show_progress;
+    }
+    return @results;
+  }
+
+  #per-worker state belongs to this process, so it outlives the workers
+  my %by_class;
+  for my $job (@jobs) {
+    next unless ref( $job ) eq 'HASH' and ref( $job->{OBJECT} );
+    push @{$by_class{ref( $job->{OBJECT} )}}, $job->{OBJECT};
+  }
+  my @worker_classes = grep { $_->can( 'enter_worker' ) }
+    sort( keys( %by_class ) );
+  for my $class (@worker_classes) {
+    if( $class->can( 'prepare_workers' ) ) {
+      $class->prepare_workers( $nworkers, @{$by_class{$class}} );
+    }
+  }
+
+  #anything still buffered would otherwise be written again by each worker
+  STDOUT->flush();
+  STDERR->flush();
+  $self->{DATA_LOG}->flush() if defined $self->{DATA_LOG};
+
+  my %workers;
+  my $select = IO::Select->new();
+  for my $w (1..$nworkers) {
+    my( $job_r, $job_w, $res_r, $res_w ) = map { IO::Handle->new() } (1..4);
+    pipe( $job_r, $job_w ) or die "Can't create job pipe: $!";
+    pipe( $res_r, $res_w ) or die "Can't create result pipe: $!";
+    my $pid = fork();
+    die "Can't fork fitness worker: $!" unless defined $pid;
+    if( $pid == 0 ) {
+      close $job_w;
+      close $res_r;
+      $res_w->autoflush( 1 );
+      srand();
+      eval {
+	$_->enter_worker( $w ) for @worker_classes;
+	while( my $idx = <$job_r> ) {
+	  chomp $idx;
+	  #a job that dies scores 0, rather than taking the worker (and the
+	  #parent's END blocks) with it
+	  my $result = eval { &$fn( $jobs[$idx] ) };
+	  if( $@ ) {
+	    print STDERR "fitness job $idx failed: $@";
+	    $result = 0;
+	  }
+	  $result = 0 unless defined $result;
+	  print $res_w "$idx $result\n";
+	}
+      };
+      #skip END blocks and destructors, which belong to the parent
+      POSIX::_exit( 0 );
+    }
+    close $job_r;
+    close $res_w;
+    $job_w->autoflush( 1 );
+    $workers{fileno( $res_r )} = { PID => $pid,
+				   JOBS => $job_w,
+				   RESULTS => $res_r };
+    $select->add( $res_r );
+  }
+
+  my $next = 0;
+  my $ndone = 0;
+  my $dispatch = sub {
+    my $w = shift;
+    if( $next < @jobs ) {
+      print { $w->{JOBS} } "$next\n";
+      $next++;
+    } else {
+      #out of work: the worker exits, and its EOF isn't of interest
+      close $w->{JOBS};
+      $select->remove( $w->{RESULTS} );
+    }
+  };
+  for my $w (values( %workers )) {
+    &$dispatch( $w );
+  }
+  while( $ndone < @jobs ) {
+    for my $fh ($select->can_read()) {
+      my $w = $workers{fileno( $fh )};
+      my $line = <$fh>;
+      unless( defined $line and $line =~ /^(\d+) (.*)$/ ) {
+	die "fitness worker $w->{PID} exited unexpectedly";
+      }
+      $results[$1] = $2;
+      $ndone++;
+      progress_dots( 50, $ndone, (@jobs + 0) ) if $show_progress;
+      &$dispatch( $w );
+    }
+  }
+  for my $w (values( %workers )) {
+    close $w->{RESULTS};
+    waitpid( $w->{PID}, 0 );
+  }
+  return @results;
+}
+
 sub save_state {
   my $self = shift;
   my $file = shift;
@@ -317,6 +734,8 @@ sub save_state {
     push @savepop, \%nu;
   }
   my $state = { GENERATION => $self->generation_count(),
+		TURNOVER => $self->{TURNOVER},
+		MIGRATION_SEEN => $self->{MIGRATION_SEEN},
 		POPULATION => \@savepop };
   Storable::nstore( $state, $file );
 }
@@ -332,12 +751,22 @@ sub load_state {
   }
   my @pop = @{$state->{POPULATION}};
   $self->{GENERATION} = $state->{GENERATION};
+  $self->{TURNOVER} = $state->{TURNOVER};
+  $self->{MIGRATION_SEEN} = $state->{MIGRATION_SEEN};
   for my $ind (@pop) {
     my $obj = $self->load_individual( $self->dir(), $ind->{ID} );
     my $individual = $self->add_individual( $ind->{ID}, $obj );
     while( my($k,$v) = each(%$ind) ) {
       $individual->{$k} = $v;
     }
+    #states from before SAMPLES was kept: average_over samples when new,
+    #and one a generation since
+    if( defined $individual->{FITNESS} and
+	not defined $individual->{SAMPLES} ) {
+      my $avg_over = $self->average_over();
+      $avg_over = 1 unless defined $avg_over;
+      $individual->{SAMPLES} = $avg_over + $individual->{AGE} - 1;
+    }
   }
   return 1;
 }
@@ -421,6 +850,24 @@ $individual should combine with the zero or more mates supplied to produce a sin
 
 All files used to store this individual should be purged from the project dir.
 
+=item $individual->prepare_fitness
+
+Optional.  If the individual provides this method, it is called once before test_fitness() is sampled for the individual, and should do any setup which the samples share.  When fitness_workers is greater than 1 the samples of one individual may run at the same time in different processes, so test_fitness() should not do such setup itself.
+
+=item <class>->save_population( <project_dir>, <id> => <individual>, ... )
+
+Optional.  A class method which saves each of the individuals as save() would.  If the class provides it, Evolver saves each generation's new individuals (and the starting population) with one call, after breeding them all, instead of calling save() on each.
+
+=item <class>->prepare_population( @individuals )
+
+Optional.  A class method, called (before prepare_fitness()) with every individual of the class whose fitness is about to be sampled, so that setup which is cheaper done in bulk can be done once per generation.  It is called in the Evolver process itself.
+
+=item <class>->prepare_workers( $count, @individuals )
+
+=item <class>->enter_worker( $slot )
+
+Optional class methods, for state which fitness workers should keep for the whole run, such as a server process, rather than set up afresh in every worker.  With fitness_workers greater than 1, workers are forked again for each batch of samples; before forking them, Evolver calls prepare_workers() in its own process with the number of workers and the individuals about to be sampled, and each worker calls enter_worker() with its slot (1 to $count) before its first sample.  Whatever prepare_workers() sets up for a slot is inherited by that slot's worker every time.
+
 =back
 
 =head1 CONFIGURATION
@@ -465,10 +912,32 @@ Contains a sub reference which takes as its argument the project dir.  Should re
 
 If this option is supplied, it specifies the number of times test_fitness() will be called and the values averaged together to calculate the fitness for new individuals.
 
+=item racing
+
+If set, fitness is sampled as a race rather than a fixed number of times: new individuals get one sample, and after that only those which might still fall either side of the kill boundary (between the individuals kill() would take and the rest, going by last generation's turnover) or the selection boundary get more, one round at a time, up to average_over for new individuals and one a generation for the rest.  An individual is out of the race once its fitness is more than <racing> standard errors from both boundaries, the standard deviation of a sample being pooled over the population.  2 is a sensible value.  FITNESS stays the mean of all the samples an individual has had.  Each generation's fitness_samples in the data log counts the test_fitness() calls made.
+
 =item rm_killed
 
 If this option is present, and true, kill_files() will be called on all individuals removed from the population.
 
+=item fitness_workers
+
+The number of processes used to calculate fitness.  Each generation, the fitness samples needed (one for every individual, average_over for new ones) are handed out to this many forked workers, and the results are collected in a fixed order before selection, kill and breeding.  Defaults to 1, which calculates fitness in the Evolver process itself.
+
+=item migration_dir
+
+Turns on island mode.  Several Evolvers, each with its own project dir (and so its own population, state and config), on one machine or several sharing a filesystem, can exchange individuals through this directory.  Every migration_interval generations (default 5), after fitness is calculated, an island saves copies of its best migration_count individuals (default 2) with their FITNESS, under <migration_dir>/<island>/<generation>, and takes in whatever the other islands have sent since it last looked, in place of its worst individuals (at most half the population is replaced at once).  Immigrants keep their FITNESS, sample count and age, and are saved in the project dir like any other individual; which packets each island has taken in is kept in the state.  An island keeps its last 4 packets, so one which falls further behind than that misses some migrants.  The islands should evolve the same problem with compatible configs, since fitness is compared across them.
+
+=item island
+
+The island's name in migration_dir.  Defaults to the host name and the last component of the project dir, joined by '_'.
+
+=item migration_interval
+
+=item migration_count
+
+See migration_dir.
+
 =back
 
 =head2 Other Directives
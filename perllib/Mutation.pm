@@ -9,10 +9,16 @@ Mutation - mutate binary neural network genomes used by NetCompiler
  cross_genomes( <in1>, <in2>, <outfile> [, optional args] );
  purge_introns( <infile>, <outfile> );
 
+ $child = mutate_genome_buffer( $genome, <mutation_level> );
+ $child = cross_genome_buffers( $genome1, $genome2 [, optional args] );
+ $child = purge_introns_buffer( $genome );
+
 =head1 DESCRIPTION
 
 Mutation implements fairly brain-dead mutation and crossover functionality for network genomes.  These functions only know that the genetic code is composed of 4-byte blocks.
 
+Each operation comes in two forms: one working on genomes held in memory as strings of bytes (as NetCompiler reads with its 'data' option), and one reading and writing files, which is a wrapper for the first.  Breeding a whole generation in memory saves a temporary file per step.
+
 =head1 INTERFACE
 
 =over
@@ -34,13 +40,29 @@ Makes an imperfect copy of infile to outfile.  The <mutation_level> specifies ho
 sub mutate_genome {
   my $in_filename = shift;
   my $out_filename = shift;
-  # mutation level goes from 0 to 100
-  # this represents the number of integer alterations in 1000 ints
   my $mutation_level = shift;
   if( @_ ) {
     $mutation_level = shift;
   }
 
+  my $genome = read_genome( $in_filename );
+  defined $genome or croak( "Can't open source genome ($in_filename): $!" );
+  write_genome( $out_filename, mutate_genome_buffer( $genome, $mutation_level ) )
+    or croak( "Can't open output ($out_filename): $!" );
+}
+
+=item $child = mutate_genome_buffer( $genome, <mutation_level> )
+
+Returns an imperfect copy of the genome in the string $genome, mutated as by mutate_genome().  For the same random number sequence, the two give the same result.
+
+=cut
+
+sub mutate_genome_buffer {
+  my $genome = shift;
+  # mutation level goes from 0 to 100
+  # this represents the number of integer alterations in 1000 ints
+  my $mutation_level = shift;
+
   #mutation methods:
   # changes to single ints:
   #   change value
@@ -48,41 +70,21 @@ sub mutate_genome {
   #   delete
   # displace a section
 
-  #NetCompiler::_is_node_start( $n );
-
-  my $in = new IO::File( "<$in_filename" )
-    or croak( "Can't open source genome ($in_filename): $!" );
-
-  my $out = new IO::File( ">$out_filename" )
-    or croak( "Can't open output ($out_filename): $!" );
-
   # skip over the immutable options
-  my $buf;
-  my $immutable_len = NetCompiler::_genome_immutable_options_count() * 4;
-  my $len = $in->read( $buf, $immutable_len );
-  unless( $len == $immutable_len ) {
-    die "Can't even read immutable options: $!";
+  my $immutable_len = NetCompiler::_genome_immutable_options_count( $genome ) * 4;
+  unless( length( $genome ) >= $immutable_len ) {
+    die "Can't even read immutable options";
   }
+  my $out = substr( $genome, 0, $immutable_len );
 
-  print $out ( $buf );
-  my $remainderbuf;
-  while( not $in->eof() ) {
-    $len = $in->read( $buf, 2000 * 4 );
-    if( defined $remainderbuf ) {
-      $len += length( $remainderbuf );
-      $buf = $remainderbuf . $buf;
-      undef $remainderbuf;
-    }
+  #mutations are spread over blocks of 2000 integers
+  for( my $pos = $immutable_len; $pos < length( $genome ); $pos += 2000 * 4 ) {
+    my $buf = substr( $genome, $pos, 2000 * 4 );
+    my $len = length( $buf );
     my $int_count = int($len/4);
-    my $remainder = $len % 4;
     my $mutacount = int(($int_count/1000) * $mutation_level) + 1;
-    my $intbuf = substr( $buf, 0, $int_count * 4 );
-    if( $remainder ) {
-      $remainderbuf = substr( $buf, $int_count * 4, $remainder );
-    }
-    undef $buf;
     #turn the bytes into an array of integers:
-    my @ints = unpack( "N*", $intbuf );
+    my @ints = unpack( "N*", substr( $buf, 0, $int_count * 4 ) );
     #now decide what mutation events will occur
     my $alter_count = 0;
     my $insert_count = 0;
@@ -104,7 +106,6 @@ sub mutate_genome {
       # select from all starting/ending points s.t. there is enough stuff after
       my $move_from = int(rand($int_count - $relocate_len)) + 1;
       my $move_to = int(rand($int_count - $relocate_len)) + 1;
-      #print "Relocating $relocate_len integers from $move_from to $move_to\n";
       # divide array into: |---pre move---|---moved---|---post move---|
       my $premove_end = $move_from - 1;
       my $move_end = $move_from + $relocate_len - 1;
@@ -128,9 +129,7 @@ sub mutate_genome {
     }
     for my $i (1..$delete_count) {
       my $delete_location = int(rand($int_count-1));
-      my @postdel = @ints[($delete_location+1)..$#ints];
-      delete @ints[$delete_location..$#ints];
-      push @ints, @postdel;
+      splice( @ints, $delete_location, 1 );
       #delete operation changes the number of integers
       $int_count = @ints + 0;
     }
@@ -140,21 +139,17 @@ sub mutate_genome {
     }
     for my $i (1..$insert_count) {
       my $insert_location = int(rand($int_count));
-      my @postins = @ints[$insert_location..$#ints];
-      delete @ints[$insert_location..$#ints];
       my $new = int(rand(2**32));
-      push @ints, $new, @postins;
+      splice( @ints, $insert_location, 0, $new );
       #insert operation changes the number of integers
       $int_count = @ints + 0;
     }
     #mutation steps are done, so output altered data:
-    print $out ( pack( "N*", @ints ) );
+    $out .= pack( "N*", @ints );
+    #a partial integer can only be left at the very end
+    $out .= substr( $buf, $len - $len % 4 ) if $len % 4;
   }
-  if( defined $remainderbuf ) {
-    print $out ( $remainderbuf );
-  }
-  $in->close();
-  $out->close();
+  return $out;
 }
 
 =item cross_genomes( <in1>, <in2>, <out> [, min [, max [, exponent ] ] ] )
@@ -175,6 +170,24 @@ sub cross_genomes {
   my $in2_filename = shift;
   my $out_filename = shift;
 
+  my $genome1 = read_genome( $in1_filename );
+  defined $genome1 or die "Can't open source genome ($in1_filename): $!";
+  my $genome2 = read_genome( $in2_filename );
+  defined $genome2 or die "Can't open source genome ($in2_filename): $!";
+  write_genome( $out_filename, cross_genome_buffers( $genome1, $genome2, @_ ) )
+    or die "Can't open output ($out_filename): $!";
+}
+
+=item $child = cross_genome_buffers( $genome1, $genome2 [, min [, max [, exponent ] ] ] )
+
+Returns the crossover of the genomes in the strings $genome1 and $genome2, as cross_genomes() would write it.
+
+=cut
+
+sub cross_genome_buffers {
+  my $genome1 = shift;
+  my $genome2 = shift;
+
   #cumulative chance of crossover
   my $min_cross = 20;
   my $max_cross = 750;
@@ -189,122 +202,133 @@ sub cross_genomes {
   if( @_ ) {
     $cross_xpn = shift;
   }
-  # 0   1   2     3    4   5   6    7     8     9    10     11      12
-  #dev ino mode nlink uid gid rdev size atime mtime ctime blksize blocks
-  my @stat1 = stat($in1_filename);
-  die "can't stat $in1_filename: $!" unless @stat1;
-  my @stat2 = stat($in2_filename);
-  die "can't stat $in2_filename: $!" unless @stat2;
-
-  my $in1_size = $stat1[7];
-  my $in2_size = $stat2[7];
-
-  #open the input and output files,
-  my $in1 = new IO::File( "<$in1_filename" )
-    or die "Can't open source genome ($in1_filename): $!";
-  my $in2 = new IO::File( "<$in2_filename" )
-    or die "Can't open source genome ($in2_filename): $!";
-  my $out = new IO::File( ">$out_filename" ) 
-    or die "Can't open output ($out_filename): $!";
 
-  my $immutable_len = NetCompiler::_genome_immutable_options_count() * 4;
+  my $immutable_len = NetCompiler::_genome_immutable_options_count( $genome1 ) * 4;
+  my $out = substr( $genome1, 0, $immutable_len );
+
+  #( genome, read position ) for the active genome, then the other
+  my @active = ( \$genome1, $immutable_len );
+  my @other = ( \$genome2,
+		NetCompiler::_genome_immutable_options_count( $genome2 ) * 4 );
+  for(;;) {
+    my( $in1, $pos1 ) = @active;
+    my( $in2, $pos2 ) = @other;
+    #rand defaults to range of (0,1)
+    #we want to allow large max crosses, but mostly do shorter ones
+    my $cross_len = int( $min_cross +
+			 (1 - (rand())**$cross_xpn)*($max_cross - $min_cross) );
+
+    #multiply lengths by 4, since we always work w/ 4 byte chunks
+    my $n1 = $cross_len * 4;
+    #length from the other genome (discarded) is scaled by their sizes
+    my $n2 = int($cross_len * (length( $$in2 )/length( $$in1 ))) * 4;
+
+    #data from the active genome goes to the output, the other's is skipped
+    $out .= substr( $$in1, $pos1, $n1 );
+    $pos1 += $n1;
+    $pos2 += $n2;
+    if( $pos1 >= length( $$in1 ) ) {
+      $out .= substr( $$in2, $pos2 ) if $pos2 < length( $$in2 );
+      last;
+    } elsif( $pos2 >= length( $$in2 ) ) {
+      $out .= substr( $$in1, $pos1 );
+      last;
+    }
+    #swap the two and repeat
+    @active = ( $in2, $pos2 );
+    @other = ( $in1, $pos1 );
+  }
+  if( length( $out ) % 4 != 0 ) {
+    die "data not read in 4 byte increments";
+  }
+  return $out;
+}
+
+=item purge_introns( <infile>, <outfile> )
+
+Reads through <infile>, using the start and end markers to keep track of whether the current block is part of a node definition, or not.  If it is, it is written to <outfile>, as are the option words of a versioned genome (see NetCompiler's Genome Format).  All other (non-coding) blocks are discarded.
 
-  print $out ( read_bytes( $in1, $immutable_len ) );
-  read_bytes( $in2, $immutable_len );
+=cut
 
-  _cross_the_streams( $in1, $in1_size, $in2, $in2_size, $out,
-		      $min_cross, $max_cross, $cross_xpn );
+sub purge_introns {
+  my $in_filename = shift;
+  my $out_filename = shift;
 
-  $in1->close();
-  $in2->close();
-  $out->close();
+  my $genome = read_genome( $in_filename );
+  defined $genome or die "Can't open source genome: $!";
+  write_genome( $out_filename, purge_introns_buffer( $genome ) )
+    or die "Can't open output: $!";
 }
 
-sub _cross_the_streams {
-  my( $in1, $in1_size, $in2, $in2_size, $out,
-      $min_cross, $max_cross, $cross_xpn ) = @_;
+=item $child = purge_introns_buffer( $genome )
 
-  #rand defaults to range of (0,1)
-  #we want to allow large max crosses, but mostly do shorter ones
-  my $cross_len = int( $min_cross + 
-		       (1 - (rand())**$cross_xpn)*($max_cross - $min_cross) );
+Returns the genome in the string $genome without its introns, as purge_introns() would write it.
 
-  #multiply lengths by 4, since we always work w/ 4 byte chunks
-  my $n1 = $cross_len * 4;
-  #length from 2nd file (discarded) is scaled by ratio of file sizes
-  my $n2 = int($cross_len * ($in2/$in1)) * 4;
+=cut
+
+sub purge_introns_buffer {
+  my $genome = shift;
 
-  my $bytes1 = read_bytes( $in1, $n1 );
-  my $bytes2 = read_bytes( $in2, $n2 );
-  if( (length( $bytes1 ) % 4) != 0 or
-      (length( $bytes2 ) % 4) != 0 ) {
+  my $immutable_len = NetCompiler::_genome_immutable_options_count( $genome ) * 4;
+  if( ( length( $genome ) - $immutable_len ) % 4 != 0 ) {
     die "data not read in 4 byte increments";
   }
-  #data from file 1 goes to the output, data from file 2 is discarded
-  print $out ( $bytes1 );
-  if( $in1->eof() or $in2->eof() ) {
-    my $remainder;
-    if( $in1->eof() ) {
-      $remainder = read_bytes( $in2, -1 );
-    } else {
-      $remainder = read_bytes( $in1, -1 );
+  my @ints = unpack( "N*", substr( $genome, $immutable_len ) );
+  #only a versioned genome has option words
+  my $versioned = ( $immutable_len > 8 );
+  my @outs;
+  my $in_node = 0;
+  my $node_start = 0;
+  for my $i (0..$#ints) {
+    if( $in_node and NetCompiler::_is_node_end( $ints[$i] ) ) {
+      push @outs, @ints[$node_start..$i];
+      $in_node = 0;
+    }
+    elsif( not $in_node and NetCompiler::_is_node_start( $ints[$i] ) ) {
+      $node_start = $i;
+      $in_node = 1;
     }
-    if( (length( $remainder ) % 4) != 0 ) {
-      die "data not read in 4 byte increments";
+    elsif( $versioned and not $in_node and
+	   NetCompiler::_is_option_word( $ints[$i] ) ) {
+      push @outs, $ints[$i];
     }
-    print $out ( $remainder );
-    return;
   }
-  else {
-    #reverse the two files and repeat
-    _cross_the_streams( $in2, $in2_size, $in1, $in1_size, $out,
-			$min_cross, $max_cross, $cross_xpn );
+  if( $in_node ) {
+    push @outs, @ints[$node_start..$#ints];
   }
+  return substr( $genome, 0, $immutable_len ) . pack( "N*", @outs );
 }
 
-=item purge_introns( <infile>, <outfile> )
+=item $genome = read_genome( <file> )
 
-Reads through <infile>, using the start and end markers to keep track of whether the current block is part of a node definition, or not.  If it is, it is written to <outfile>.  All other (non-coding) blocks are discarded.
+Returns the contents of <file> as a string, or undef (with $!) if it can't be read.
 
 =cut
 
-sub purge_introns {
-  my $in_filename = shift;
-  my $out_filename = shift;
+sub read_genome {
+  my $filename = shift;
+  open my $in, "<", $filename or return undef;
+  binmode $in;
+  local $/ = undef;
+  my $genome = <$in>;
+  close $in;
+  $genome = "" unless defined $genome;
+  return $genome;
+}
 
-  my $in = new IO::File( "<$in_filename" ) or die "Can't open source genome: $!";
-  my $out = new IO::File( ">$out_filename" ) or die "Can't open output: $!";
+=item write_genome( <file>, $genome )
 
-  my $immutable_len = NetCompiler::_genome_immutable_options_count() * 4;
-  print $out ( read_bytes( $in, $immutable_len ) );
+Writes the genome in the string $genome to <file>, in a single write.  Returns true on success, or false (with $!).
 
-  my $in_node = 0;
-  while( not $in->eof() ) {
-    my $buf = read_bytes( $in, 1024 * 4 );
-    if( length( $buf ) % 4 != 0 ) {
-      die "data not read in 4 byte increments";
-    }
-    my @ints = unpack( "N*", $buf );
-    my @outs;
-    my $node_start = 0;
-    for my $i (0..$#ints) {
-      if( $in_node and NetCompiler::_is_node_end( $ints[$i] ) ) {
-	push @outs, @ints[$node_start..$i];
-	$in_node = 0;
-      }
-      elsif( not $in_node and NetCompiler::_is_node_start( $ints[$i] ) ) {
-	$node_start = $i;
-	$in_node = 1;
-      }
-    }
-    if( $in_node ) {
-      push @outs, @ints[$node_start..$#ints];
-    }
-    print $out ( pack( "N*", @outs ) );
-  }
+=cut
 
-  close $in;
-  close $out;
+sub write_genome {
+  my $filename = shift;
+  my $genome = shift;
+  open my $out, ">", $filename or return 0;
+  binmode $out;
+  my $ok = print $out $genome;
+  return ( close( $out ) and $ok );
 }
 
 #nbytes = -1 means read all remaining.
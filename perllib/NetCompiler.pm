@@ -28,6 +28,7 @@ use Errorable;
 use NetCompiler::GraphViz;
 use NetCompiler::Genome;
 use NetCompiler::C;
+use NetCompiler::Blob;
 
 BEGIN {
   @NetCompiler::ISA = qw(Errorable);
@@ -47,7 +48,7 @@ Filename to read network definition from.
 
 =item data
 
-Scalar or reference of memory structure to read definition from
+The definition itself, as a string (in genome_mode, the genome's bytes) or a reference to one, so nothing need be read from disk.  In genome_mode it may also be a reference to an array of the genome's integers.
 
 =item genome_mode
 
@@ -91,7 +92,17 @@ sub _init {
 
 =item $netcompiler->compile( <type> [, <output_file>] )
 
-Compiles/translates the network loaded with new() into <type>, which must be one of "graphviz","genome", or "c".  If <output_file> is specified, writes compiled network to that file.  Returns the compiled network.
+Compiles/translates the network loaded with new() into <type>, which must be one of "graphviz","genome", "c", or "blob".  If <output_file> is specified, writes compiled network to that file.  Returns the compiled network.
+
+A "blob" is a compact binary form of the analysed network, which libneural can load with load_net() and run directly, without compiling anything (see NetCompiler::Blob for the layout).
+
+For "c", the option symbol_suffix => <suffix> appends <suffix> to the names of the functions the network exports, so that the code for several networks can be concatenated into one shared object and loaded with load_named_net().
+
+Also for "c", precision => 'float' makes the network compute in single precision instead of 'double', and activation => 'fast' replaces the exp() based sigmoid with a rational approximation (within 5e-7 of it) instead of 'exact'.  Either speeds up calculation and training; the compiled network reports which variant it is in the variant field of its net_info, and src/variant_check compares a variant's learning with the exact network's.  Blobs only come in the default, exact double precision form.
+
+fold => 1, also for "c" only, makes the network's fixed (non-random) weights constants in the generated code rather than entries in its weights: they are no longer trained, connections with a fixed weight of 0 are left out, and so are nodes which then have no path to an output.  The network does less work, but it has fewer weights (a weights file from the unfolded network won't fit it) and trains differently, which is why it isn't the default.
+
+dense => <n> (for "c", default 64) sets the size, in connections, from which a dense block -- a run of nodes taking the same inputs with random weights -- is compiled as loops over its part of the weights instead of a statement per connection.  This keeps the code, and gcc's time, in proportion to the number of nodes rather than connections, and runs at least as fast once blocks are this big.  The weights and results are the same either way; dense => 0 unrolls everything.
 
 =cut
 
@@ -109,11 +120,14 @@ sub compile {
     $output = NetCompiler::Genome::__compile_net( $self, %options );
   } elsif( $type eq 'c' ) {
     $output = NetCompiler::C::__compile_net( $self, %options );
+  } elsif( $type eq 'blob' ) {
+    $output = NetCompiler::Blob::__compile_net( $self, %options );
   }
   if( defined $filename and defined $output ) {
     $self->debug( 1,  "Compiled net is ", length($output), 
 	   " bytes -- writing to $filename\n" );
     open COMP, ">$filename" or die "Can't open $filename for output: $!";
+    binmode COMP;
     print COMP $output;
     close COMP;
     return 1;
@@ -143,6 +157,14 @@ Here is a sample network in this format:
              }
  }
 
+OPTIONS may also set FEEDBACK_LIMIT and FEEDBACK_CONVERGENCE (see opt()).
+
+=head2 Genome Format
+
+A genome is a sequence of 4 byte big-endian integers: the input and output counts, then nodes, each a start marker, one integer per connection and an end marker, with anything between nodes ignored (introns).
+
+Genomes written by this version have a version word right after the counts: a node start marker (top 7 bits 62) with 0x4E4701 in its low 25 bits, for version 1.  Older genomes can't have one there, since the first word after their counts was either an intron, which was never a start marker, or a bare start marker.  In a versioned genome, an intron integer whose top 7 bits are 61 is an option word: bits 20-24 say which option (1 for feedback_limit, 2 for feedback_convergence in millionths) and the low 20 bits are its value.  The first of each kind counts, and mutation can change them like anything else, but the values are kept to 1 to 1000 sweeps and a convergence below 1 as they are read.  In an unversioned genome, those integers are introns like any other, so older genomes keep their meaning.
+
 =head1 EXTENDING
 
 Extending NetCompiler to have additional output formats is fairly simple.  You must create a sub in a separate module which can be passed a reference to the netcompiler object, and an (optional) options hash.  There is no formal extension loading mechanism, you must edit the 'compile' sub in NetCompiler.pm, and place the call to your new sub in the if.. elsif.. sequence there.  
@@ -202,60 +224,62 @@ sub _input_file {
   }
 }
 
+#data is a string of the input, a reference to one, or a reference to an
+#array of integers (genome mode only)
 sub _input_buffer {
   my $self = shift;
   my $buffer = shift;
   $self->{_BUFFER} = $buffer;
   my $buffer_position = 0;
-  if( ref( $buffer ) ) {
-    if( ref( $buffer ) eq 'ARRAY' ) {
-      $self->{_INPUT_READER} =
-	sub { my $len = 1; 
-	      if( @_ ) { $len = shift; }
-	      return undef if $buffer_position > $#$buffer;
-	      my $oldpos = $buffer_position;
-	      $buffer_position += $len;
-	      return $buffer->[$oldpos..$buffer_position];
-	    };
-    } else {
-      $self->{_INPUT_READER} =
-	sub { return _rdstr($buffer, \$buffer_position, $self->{_READ_INTS}, @_) };
-    }
-  }
-  else {
+  if( ref( $buffer ) eq 'ARRAY' ) {
+    $self->{_INPUT_READER} =
+      sub { my $len = 1;
+	    if( @_ ) { $len = shift; }
+	    return undef if $buffer_position > $#$buffer;
+	    my $oldpos = $buffer_position;
+	    $buffer_position += $len;
+	    return $buffer->[$oldpos] if $len == 1;
+	    my $last = ( $buffer_position > @$buffer ) ? $#$buffer :
+	      $buffer_position - 1;
+	    return @{$buffer}[$oldpos..$last];
+	  };
+  } else {
+    my $stref = ref( $buffer ) ? $buffer : \$buffer;
+    my $read_ints = $self->{_READ_INTS};
     $self->{_INPUT_READER} =
-      sub { return _rdstr(\$buffer, \$buffer_position, $self->{_READ_INTS}, @_) };
+      sub { return _rdstr( $stref, \$buffer_position, $read_ints, @_ ) };
   }
   $self->{_INPUT_REWIND} = sub { $buffer_position = 0 };
   $self->{_INPUT_CLOSE} = sub { $buffer = undef };
   return 1;
 }
 
+#reads from the string $$stref at $$posref, as _input_file's readers do
+#from a file: <len> (default 1) big-endian integers if $read_ints, else
+#<len> bytes, or a line if no <len> is given
 sub _rdstr {
   my $stref = shift;
   my $posref = shift;
-  my $rdlines = shift;
+  my $read_ints = shift;
   my $len = undef;
   if( @_ ) {
     $len = shift;
   }
-  my $strlen = length( $str );
-  if( $pos >= $strlen ) {
+  my $strlen = length( $$stref );
+  if( $$posref >= $strlen ) {
     return undef;
   }
-  if( not defined( $len ) or $rdlines ) {
-    my $n = 0;
-    my $pos = $$posref;
-    while( $n < $len ) {
-      my $idx = index( $$stref, "\n", $pos );
-      if( $idx == -1 ) {
-	$pos = $strlen;
-	last;
-      } else {
-	$pos = $idx;
-      }
-    }
-    $len = $pos - $$posref;
+  if( $read_ints ) {
+    my $num = defined( $len ) ? $len : 1;
+    my $dat = substr( $$stref, $$posref, $num * 4 );
+    $$posref += length( $dat );
+    my @ret = unpack( "N*", $dat );
+    return ( $num == 1 ) ? $ret[0] : @ret;
+  }
+  unless( defined $len ) {
+    #up to and including the next newline
+    my $idx = index( $$stref, "\n", $$posref );
+    $len = ( $idx == -1 ) ? $strlen - $$posref : $idx + 1 - $$posref;
   }
   my $oldpos = $$posref;
   $$posref += $len;
@@ -381,13 +405,13 @@ sub _get_raw_node {
 
 =item $netcompiler->_list_raw_nodes
 
-Returns a list of all node IDs.
+Returns a sorted list of all node IDs.  The order is fixed so that compiling the same net twice produces identical code.
 
 =cut
 
 sub _list_raw_nodes {
   my $self = shift;
-  return keys( %{$self->{_RAW_NODES}} );
+  return sort( keys( %{$self->{_RAW_NODES}} ) );
 }
 
 =item $netcompiler->_list_raw_node_ins( <id> )
@@ -617,7 +641,7 @@ sub _list_node_taints {
   my $id = shift;
   my @ret;
   my %taints = $self->__list_taints( $id );
-  while( my( $k, $v ) = each( %taints ) ) {
+  for my $k (sort( keys( %taints ) )) {
     if( $k =~ /^NODE_(.*)$/ ) {
       push @ret, $1;
     }
@@ -653,11 +677,13 @@ sub _generate_random_weight {
 
 my %opt_keys = ( INPUTS => '_INPUT_COUNT',
 		 OUTPUTS => '_OUTPUT_COUNT',
+		 FEEDBACK_LIMIT => '_FEEDBACK_LIMIT',
+		 FEEDBACK_CONVERGENCE => '_FEEDBACK_CONVERGENCE',
 	       );
 
 =item $netcompiler->opt( 'optname' )
 
-Returns the value of the network option specified by 'optname'.  Current option names are 'inputs' and 'outputs', for the number of each in the network.
+Returns the value of the network option specified by 'optname'.  Current option names are 'inputs' and 'outputs', for the number of each in the network, and 'feedback_limit' and 'feedback_convergence', which (if set) replace libneural's defaults of 1000 sweeps and 0.05 for the relaxation of the net's feedback groups.  The convergence is kept to the nearest millionth.
 
 =cut
 
@@ -997,7 +1023,22 @@ sub _load_genome {
   }
 }
 
+#the version word written after the counts (see Genome Format)
+my $genome_version = 1;
+my $genome_version_word = ( 62 << 25 ) + ( 0x4E47 << 8 ) + $genome_version;
+
+sub _genome_version_word {
+  return $genome_version_word;
+}
+
+#the words at the head of $genome which mutation leaves alone: the counts,
+#and the version word if it has one
 sub _genome_immutable_options_count {
+  my $genome = shift;
+  if( defined $genome and length( $genome ) >= 12 and
+      unpack( "N", substr( $genome, 8, 4 ) ) == $genome_version_word ) {
+    return 3;
+  }
   return 2;
 }
 
@@ -1006,6 +1047,15 @@ sub _load_genome_options {
   #remember to add the same stuff in Genome.pm
   $self->opt( 'inputs', $self->_read_input() );
   $self->opt( 'outputs', $self->_read_input() );
+  $self->{_GENOME_VERSION} = 0;
+  my $word = $self->_read_input();
+  if( defined $word and $word == $genome_version_word ) {
+    $self->{_GENOME_VERSION} = $genome_version;
+    return 3;
+  }
+  #an older genome; the word read is its first intron or node
+  $self->_rewind_input();
+  $self->_read_input( 2 );
   return 2;
 }
 
@@ -1038,6 +1088,50 @@ sub _is_node_end {
   return (($n>>25) == 63)?1:0;
 }
 
+#option words, and the options they can set (see Genome Format)
+my @genome_options = ( undef, 'feedback_limit', 'feedback_convergence' );
+
+sub _is_option_word {
+  my $n = shift;
+  return (($n>>25) == 61)?1:0;
+}
+
+sub _genome_option_word {
+  my( $name, $value ) = @_;
+  for my $i (1..$#genome_options) {
+    next unless $genome_options[$i] eq $name;
+    $value = int( $value * 1e6 + 0.5 ) if $name eq 'feedback_convergence';
+    $value = 2**20 - 1 if $value >= 2**20;
+    return (61 << 25) + ($i << 20) + $value;
+  }
+  die "No genome option '$name'";
+}
+
+sub _genome_option_names {
+  return grep { defined } @genome_options;
+}
+
+#the most sweeps an option word can ask for: libneural's default, so
+#that a mutated word can't make a recurrent net run away with the time
+my $genome_max_feedback_limit = 1000;
+
+sub _load_genome_option {
+  my $self = shift;
+  my $word = shift;
+  my $name = $genome_options[($word >> 20) % 32];
+  my $value = $word % 2**20;
+  return unless defined $name and $value > 0;
+  return if $self->{_GENOME_OPTS_SEEN}->{$name}++;
+  if( $name eq 'feedback_convergence' ) {
+    #below 1, or one sweep would always do
+    $value = 999999 if $value > 999999;
+    $value /= 1e6;
+  } elsif( $value > $genome_max_feedback_limit ) {
+    $value = $genome_max_feedback_limit;
+  }
+  $self->opt( $name, $value );
+}
+
 sub _load_genome_intron {
   my $self = shift;
   my $ret = 0;
@@ -1048,6 +1142,9 @@ sub _load_genome_intron {
       $self->debug( 3, "Intron had length $intronlen\n" );
       last;
     }
+    if( $self->{_GENOME_VERSION} and _is_option_word( $i ) ) {
+      $self->_load_genome_option( $i );
+    }
     $intronlen++;
   }
   return $ret;
@@ -1110,7 +1207,8 @@ sub _load_hreadable {
   my @ins = ( map { "IN" . $_ } (1..$self->opt( 'inputs' )) );
   $self->_add_input_ids( @ins );
   #load nodes
-  while( my($layer, $nodelist) = each( %{$in->{LAYERS}} ) ) {
+  for my $layer (sort( keys( %{$in->{LAYERS}} ) )) {
+    my $nodelist = $in->{LAYERS}->{$layer};
     next if $layer eq 'IN';
     my $num = 0;
     for my $node (@$nodelist) {
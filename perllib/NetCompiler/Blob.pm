@@ -0,0 +1,83 @@
+package NetCompiler::Blob;
+
+use NetCompiler::C;
+
+#Serializes the analysed net into the binary form run by libneural's
+#interpreter (see neural/blob.c, which must agree with the layout here).
+#All values are native ints/doubles, so a blob is only good on the kind
+#of machine it was made on -- just like a compiled .so.
+#
+#  header:  "NNBL", then int version, input_count, output_count,
+#           weight_count, node_count, set_count, node_entry_count,
+#           in_count, out_count, feedback_limit,
+#           feedback_convergence (in millionths; both 0 for the defaults)
+#  double   fixed_weight[in_count]        starting weight of each input
+#  int      inputs[input_count]           node index of each net input
+#  int      outputs[output_count]         node index of each net output
+#  int      sets[set_count][3]            flags, first node entry, end
+#  int      nodes[node_entry_count][6]    node, flags, in start/end,
+#                                         out start/end
+#  int      ins[in_count][3]              source node, weight index, flags
+#  int      outs[out_count][3]            dest node, weight index, flags
+#
+#Node indices are positions in the node_values array (the compiled
+#code's order), and the in/out lists are CSR-style ranges into ins/outs.
+
+my $BLOB_VERSION = 1;
+
+#flag bits, as in neural_blob.h:
+my $SET_FEEDBACK = 1;
+my $NODE_OUTPUT = 1;
+my $LINK_FB_GROUP = 1;
+my $LINK_RANDOM = 2;
+
+sub __compile_net {
+  my $net = shift;
+  my %opt = @_;
+
+  #the interpreter only does the exact, double precision net
+  die "blobs are double precision only" if( defined $opt{precision} and
+					    $opt{precision} ne 'double' );
+  die "blobs only have the exact activation" if( defined $opt{activation} and
+						 $opt{activation} ne 'exact' );
+  die "blobs can't fold weights" if $opt{fold};
+  my %vars = NetCompiler::C::_template_vars( $net );
+  my %index;
+  my $i = 0;
+  for my $id (@{$vars{all}}) {
+    $index{$id} = $i++;
+  }
+
+  my( @fixed, @sets, @nodes, @ins, @outs );
+  for my $set (@{$vars{calc_sets}}) {
+    push @sets, ($set->{feedback} ? $SET_FEEDBACK : 0), @nodes/6;
+    for my $node (@{$set->{nodes}}) {
+      push @nodes, $index{$node->{id}},
+	($node->{is_output_node} ? $NODE_OUTPUT : 0), @ins/3;
+      for my $in (@{$node->{in}}) {
+	push @fixed, $in->{orig_weight};
+	push @ins, $index{$in->{id}}, $in->{weight_index},
+	  ($in->{in_fb_group} ? $LINK_FB_GROUP : 0) |
+	    ($in->{random} ? $LINK_RANDOM : 0);
+      }
+      push @nodes, @ins/3, @outs/3;
+      for my $out (@{$node->{out}}) {
+	push @outs, $index{$out->{id}}, $out->{weight_index},
+	  ($out->{in_fb_group} ? $LINK_FB_GROUP : 0);
+      }
+      push @nodes, @outs/3;
+    }
+    push @sets, @nodes/6;
+  }
+
+  return pack( 'a4 i11 d* ', 'NNBL', $BLOB_VERSION,
+	       $vars{input_count}, $vars{output_count},
+	       $vars{weight_count}, $vars{all_count},
+	       @sets/3, @nodes/6, @ins/3, @outs/3,
+	       $vars{feedback_limit}, $vars{feedback_convergence_ppm}, @fixed ) .
+    pack( 'i*', (map { $index{$_} } (@{$vars{inputs}}, @{$vars{outputs}})),
+	  @sets, @nodes, @ins, @outs );
+}
+
+1;
+#end
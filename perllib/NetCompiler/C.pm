@@ -2,10 +2,97 @@ package NetCompiler::C;
 
 use Template;
 
+#options: symbol_suffix => <suffix> appends <suffix> to the names of the
+#functions the net exports (_calc_net<suffix> etc), so that several nets
+#can be compiled into one shared object
+#
+#precision => 'double' (default) or 'float' does the net's arithmetic in
+#that type (weights and node values are still passed around as doubles),
+#and activation => 'exact' (default) or 'fast' swaps exp() in the sigmoid
+#for a rational approximation.  The choice shows up in net_info's variant.
+#
+#fold => 1 treats the net's fixed (non-random) weights as constants: they
+#go into the code as literals instead of weights[] entries, are never
+#trained, and connections fixed at 0 are dropped along with any nodes
+#that no longer lead to an output.  weight_count only counts the random
+#weights, so weights saved from the unfolded net don't fit, and since the
+#fixed weights no longer learn, the net trains differently.
+#
+#dense => <n> writes each block of at least <n> connections (default 64)
+#where a run of nodes all take the same inputs, with random weights laid
+#out one node after another, as loops over that part of weights[] rather
+#than a statement per connection (see _dense_blocks).  The weights and
+#the results are the same as the unrolled code's; 0 unrolls everything.
+
+#variant bits, as in neural.h
+my $VARIANT_FLOAT = 1;
+my $VARIANT_FAST_SIGMOID = 2;
+
 sub __compile_net {
   my $net = shift;
   my %opt = @_;
 
+  if( defined $opt{symbol_suffix} and $opt{symbol_suffix} !~ /^\w*$/ ) {
+    die "symbol_suffix must be a C identifier: '$opt{symbol_suffix}'";
+  }
+
+  my %vars = _template_vars( $net, fold => $opt{fold},
+			     dense => ( defined( $opt{dense} ) ?
+					$opt{dense} : 64 ) );
+  $vars{symbol_suffix} = $opt{symbol_suffix};
+  %vars = ( %vars, _variant_vars( %opt ) );
+
+  my $template = Template->new( { START_TAG => '(?:\}\ {0,2})?\[\%',
+				  END_TAG => '\%\](?:\ {0,2}\{)?',
+				  PRE_CHOMP => 2,
+				  ABSOLUTE => 1,
+				  RELATIVE => 1,
+				} );
+
+  my $code = "";
+  #figure out where this module was loaded from - network.c.tmpl is in the same dir
+  my $loc = $INC{"NetCompiler/C.pm"};
+  $loc =~ s/\/[^\/]*$//g;
+  #print "LOC: $loc\n";
+  
+  $template->process( "$loc/network.c.tmpl", \%vars, \$code ) or
+    die $template->error();
+  $code =~ s/; ;/;/gs;
+  return $code;
+}
+
+#the names network.c.tmpl uses for the chosen precision and activation
+sub _variant_vars {
+  my %opt = @_;
+  my $precision = defined( $opt{precision} ) ? $opt{precision} : 'double';
+  my $activation = defined( $opt{activation} ) ? $opt{activation} : 'exact';
+  die "unknown precision '$precision'" unless $precision =~ /^(double|float)$/;
+  die "unknown activation '$activation'" unless $activation =~ /^(exact|fast)$/;
+
+  my $f = ( $precision eq 'float' ) ? '_f' : '';
+  my $fast = ( $activation eq 'fast' ) ? 'fast_' : '';
+  return ( real => $precision,
+	   sigmoid => "${fast}sigmoid$f",
+	   dsigmoid => "Dsigmoid$f",
+	   sigmoid_lanes => uc( "${fast}sigmoid$f" ) . "_LANES",
+	   lanes => "net_lanes$f",
+	   mask => "net_mask$f",
+	   dense_weight => "DENSE_WEIGHT" . uc( $f ),
+	   dense_replica_weight => "DENSE_REPLICA_WEIGHT" . uc( $f ),
+	   variant => ( $f ? $VARIANT_FLOAT : 0 ) |
+	     ( $fast ? $VARIANT_FAST_SIGMOID : 0 ),
+	 );
+}
+
+#the analysed net, in the form network.c.tmpl (and NetCompiler::Blob) use:
+#calc_sets, each a list of nodes with their inputs and outputs and the
+#weight index of each connection, in compute order.  With fold => 1, the
+#fixed connections are constants instead (see _fold_weights), and with
+#dense => <n> large dense blocks are marked (see _dense_blocks).
+sub _template_vars {
+  my $net = shift;
+  my %opt = @_;
+
   my $weight_idx = 0;
   my @calc_groups = $net->_calc_groups();
 
@@ -51,12 +138,19 @@ sub __compile_net {
     $set_start = 1;
   }
   #print "Weight idx table:\n", Data::Dumper::Dumper( \%weight_idx_table );
+  if( $opt{fold} ) {
+    $weight_idx = _fold_weights( $net, \@calc_sets, \@all,
+				 \%weight_idx_table );
+  }
 
   #now we have to go through and set the weight index for all outputs:
   for my $set (@calc_sets) {
     for my $node (@{$set->{nodes}}) {
       for my $out (@{$node->{out}}) {
-	$out->{weight_index} = $weight_idx_table{$out->{id}}->{$node->{id}};
+	my $in = $weight_idx_table{$out->{id}}->{$node->{id}};
+	$out->{weight_index} = $in->{weight_index};
+	$out->{fixed} = $in->{fixed};
+	$out->{weight} = $in->{weight};
       }
     }
   }
@@ -70,11 +164,35 @@ sub __compile_net {
     }
   }
 
+  my @dense_back = _dense_blocks( \@calc_sets, $opt{dense} );
+
   my @reverse_calc_sets;
   for my $set (@calc_sets) {
     unshift @reverse_calc_sets, $set;
   }
 
+  #node_values positions, for warm starts, and feedback group numbers, for
+  #the sweep counts
+  my %index;
+  $i = 0;
+  for my $id (@all) {
+    $index{$id} = $i++;
+  }
+  my $feedback_groups = 0;
+  for my $set (@calc_sets) {
+    for my $node (@{$set->{nodes}}) {
+      $node->{index} = $index{$node->{id}};
+    }
+    if( $set->{feedback} ) {
+      $set->{group} = $feedback_groups++;
+    }
+  }
+
+  #the net's own feedback settings, 0 for libneural's defaults; the
+  #convergence goes in millionths so the SO and blob agree exactly
+  my $limit = $net->opt( 'feedback_limit' );
+  my $convergence = $net->opt( 'feedback_convergence' );
+
 
   my %vars = ( all => \@all,
 	       all_count => (@all + 0),
@@ -86,26 +204,14 @@ sub __compile_net {
 	       output_count => $net->opt( 'outputs' ),
 	       weight_count => $weight_idx,
 	       feedbacks => \@feedbacks,
+	       dense_back => \@dense_back,
+	       feedback_groups => $feedback_groups,
+	       feedback_limit => ( $limit ? int( $limit ) : 0 ),
+	       feedback_convergence_ppm =>
+	         ( $convergence ? int( $convergence * 1e6 + 0.5 ) : 0 ),
 	     );
   #print Data::Dumper::Dumper( \%vars );
-
-  my $template = Template->new( { START_TAG => '(?:\}\ {0,2})?\[\%',
-				  END_TAG => '\%\](?:\ {0,2}\{)?',
-				  PRE_CHOMP => 2,
-				  ABSOLUTE => 1,
-				  RELATIVE => 1,
-				} );
-
-  my $code = "";
-  #figure out where this module was loaded from - network.c.tmpl is in the same dir
-  my $loc = $INC{"NetCompiler/C.pm"};
-  $loc =~ s/\/[^\/]*$//g;
-  #print "LOC: $loc\n";
-  
-  $template->process( "$loc/network.c.tmpl", \%vars, \$code ) or
-    die $template->error();
-  $code =~ s/; ;/;/gs;
-  return $code;
+  return %vars;
 }
 
 sub _node_with_inputs {
@@ -129,7 +235,12 @@ sub _node_with_inputs {
   my $in_count = 0;
   my $fb_in_count = 0;
   my $norm_in_count = 0;
-  while( my( $in, $weight ) = each(%ins) ) {
+  my %seen;
+  #walk the inputs in their listed order, so the weight layout (and the
+  #generated code) doesn't depend on hash order
+  for my $in ($net->_list_raw_node_ins( $id )) {
+    next if $seen{$in}++;
+    my $weight = $ins{$in};
     next if $net->_disconnect_taint( $in );
     $in_count++;
     my $in_fb_grp = 0;
@@ -146,7 +257,7 @@ sub _node_with_inputs {
 		 weight_index => $$weight_idx,
 		 in_fb_group => $in_fb_grp,
 	       };
-    $weight_idx_table->{$id}->{$in} = $$weight_idx;
+    $weight_idx_table->{$id}->{$in} = $ins[-1];
     $$weight_idx += 1;
   }
   my @outs;
@@ -182,5 +293,184 @@ sub _node_with_inputs {
 	 };
 }
 
+#The fold => 1 pass over calc_sets: fixed weights become constants
+#(weight, as a C literal, with fixed set), fixed zeros are dropped, and
+#then so are the nodes which no longer lead to an output.  Nodes in
+#feedback groups only go with their whole group, so the groups settle
+#just as before.  The random weights are renumbered, in the same order,
+#and their count returned; weight_idx_table is rebuilt to match.
+sub _fold_weights {
+  my $net = shift;
+  my $calc_sets = shift;
+  my $all = shift;
+  my $weight_idx_table = shift;
+
+  my( %node, %group );
+  for my $set (@$calc_sets) {
+    for my $node (@{$set->{nodes}}) {
+      $node{$node->{id}} = $node;
+      $group{$node->{id}} = $set->{nodes} if $set->{feedback};
+      my @ins;
+      for my $in (@{$node->{in}}) {
+	unless( $in->{random} ) {
+	  next if $in->{orig_weight} == 0;
+	  $in->{fixed} = 1;
+	  $in->{weight} = sprintf( "%.17g", $in->{orig_weight} );
+	}
+	push @ins, $in;
+      }
+      $node->{in} = \@ins;
+    }
+  }
+
+  #walk back from the outputs over what's left; a feedback group is live
+  #as a whole
+  my %live;
+  my @todo = $net->_output_ids();
+  while( @todo ) {
+    my $id = shift @todo;
+    next if $live{$id}++;
+    next unless $node{$id};
+    push @todo, map { $_->{id} } @{$node{$id}->{in}};
+    push @todo, map { $_->{id} } @{$group{$id}} if $group{$id};
+  }
+  my %input = map { $_ => 1 } $net->_input_ids();
+  for my $set (@$calc_sets) {
+    $set->{nodes} = [ grep { $live{$_->{id}} } @{$set->{nodes}} ];
+  }
+  @$calc_sets = grep { @{$_->{nodes}} } @$calc_sets;
+  my %kept;
+  for my $set (@$calc_sets) {
+    $kept{$_->{id}} = 1 for @{$set->{nodes}};
+  }
+  @$all = grep { $kept{$_} or $input{$_} } @$all;
+
+  #renumber, and recount each node's connections
+  my $weight_idx = 0;
+  %$weight_idx_table = ();
+  for my $set (@$calc_sets) {
+    for my $node (@{$set->{nodes}}) {
+      for my $in (@{$node->{in}}) {
+	$in->{weight_index} = $in->{fixed} ? undef : $weight_idx++;
+	$weight_idx_table->{$node->{id}}->{$in->{id}} = $in;
+      }
+      $node->{in_count} = @{$node->{in}};
+      $node->{fb_in_count} = grep { $_->{in_fb_group} } @{$node->{in}};
+      $node->{norm_in_count} = $node->{in_count} - $node->{fb_in_count};
+    }
+  }
+  for my $set (@$calc_sets) {
+    for my $node (@{$set->{nodes}}) {
+      $node->{out} = [ grep { $weight_idx_table->{$_->{id}}->{$node->{id}} }
+		       @{$node->{out}} ];
+      $node->{out_count} = @{$node->{out}};
+      $node->{fb_out_count} = grep { $_->{in_fb_group} } @{$node->{out}};
+      $node->{norm_out_count} = $node->{out_count} - $node->{fb_out_count};
+    }
+  }
+  return $weight_idx;
+}
+
+#Finds the dense blocks in the non-feedback calc sets: runs of nodes
+#with the same inputs, in the same order, all with random weights whose
+#indices go node by node (block base + node * inputs + input), with at
+#least $min connections in all.  The first node of each block gets
+#dense_start, and every node in it dense: the block, with its in (source
+#ids), nodes (its own ids), in_count, node_count, base and size.
+#
+#A source node in an earlier set whose outputs are exactly the block's
+#nodes, in order, can take its error term from the block's
+#back-propagated sums instead of its own; it gets back_dense (block and
+#pos, its place in the block's inputs), and the block back and a place
+#in its set's dense list, where the sums are worked out.  Returns the
+#blocks with back set.
+sub _dense_blocks {
+  my $calc_sets = shift;
+  my $min = shift;
+
+  $_->{dense} = [] for @$calc_sets;
+  return () unless $min;
+  my( %node, %set_of );
+  for my $i (0 .. $#$calc_sets) {
+    for my $node (@{$calc_sets->[$i]->{nodes}}) {
+      $node{$node->{id}} = $node;
+      $set_of{$node->{id}} = $i;
+    }
+  }
+  my @blocks;
+  my @back;
+  for my $set_idx (0 .. $#$calc_sets) {
+    my $set = $calc_sets->[$set_idx];
+    next if $set->{feedback};
+    my @nodes = @{$set->{nodes}};
+    my $i = 0;
+    while( $i < @nodes ) {
+      my $key = _dense_key( $nodes[$i] );
+      my $j = $i + 1;
+      if( defined $key ) {
+	while( $j < @nodes and ( _dense_key( $nodes[$j] ) || '' ) eq $key ) {
+	  $j++;
+	}
+      }
+      my @run = @nodes[$i .. $j - 1];
+      $i = $j;
+      next unless defined $key;
+      my $in_count = @{$run[0]->{in}};
+      next if @run * $in_count < $min;
+      my $base = $run[0]->{in}->[0]->{weight_index};
+      my $contiguous = 1;
+      for my $o (0 .. $#run) {
+	for my $k (0 .. $in_count - 1) {
+	  if( $run[$o]->{in}->[$k]->{weight_index} != $base + $o * $in_count + $k ) {
+	    $contiguous = 0;
+	  }
+	}
+      }
+      next unless $contiguous;
+      my $block = { id => scalar( @blocks ),
+		    in => [ map { $_->{id} } @{$run[0]->{in}} ],
+		    nodes => [ map { $_->{id} } @run ],
+		    in_count => $in_count,
+		    node_count => scalar( @run ),
+		    base => $base,
+		    size => @run * $in_count,
+		    back => 0,
+		  };
+      push @blocks, $block;
+      $_->{dense} = $block for @run;
+      $run[0]->{dense_start} = 1;
+
+      my $outs = join( ",", @{$block->{nodes}} );
+      for my $pos (0 .. $in_count - 1) {
+	my $src = $node{$block->{in}->[$pos]};
+	next if( !$src or $src->{is_output_node} );
+	#the sums are made after the block's set, so only sources in earlier
+	#(non-feedback) sets see the same errors as they would unrolled
+	next if( $set_of{$src->{id}} >= $set_idx or
+		 $calc_sets->[$set_of{$src->{id}}]->{feedback} );
+	next unless join( ",", map { $_->{id} } @{$src->{out}} ) eq $outs;
+	$src->{back_dense} = { block => $block->{id}, pos => $pos };
+	unless( $block->{back} ) {
+	  $block->{back} = 1;
+	  push @{$set->{dense}}, $block;
+	  push @back, $block;
+	}
+      }
+    }
+  }
+  return @back;
+}
+
+#the inputs of a node which could be in a dense block, as a string, or
+#undef if it can't be
+sub _dense_key {
+  my $node = shift;
+  return undef unless @{$node->{in}};
+  for my $in (@{$node->{in}}) {
+    return undef if( !$in->{random} or $in->{in_fb_group} );
+  }
+  return join( ",", map { $_->{id} } @{$node->{in}} );
+}
+
 1;
 #end
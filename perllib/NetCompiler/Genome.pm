@@ -5,10 +5,19 @@ sub __compile_net {
   my %opt = @_;
   my @intarray;
 
-  #first, the options:
+  #first, the options, and the version word which says option words
+  #may follow:
   push @intarray, ( $net->opt( 'inputs' ),
-		    $net->opt( 'outputs' )
+		    $net->opt( 'outputs' ),
+		    NetCompiler::_genome_version_word()
 		  );
+  #then any other options set, as option words ahead of the first node
+  for my $name (NetCompiler::_genome_option_names()) {
+    my $value = $net->opt( $name );
+    if( $value ) {
+      push @intarray, NetCompiler::_genome_option_word( $name, $value );
+    }
+  }
 
   my @nodes;
   my @inputs = $net->_input_ids();
@@ -57,10 +66,11 @@ sub __compile_net {
       my $intron_len = int( rand( $opt{introns}->{max} ) )+ $opt{introns}->{min};
       for my $i (1..$intron_len) {
 	my $rval;
-	#node start markers are the only forbidden items in introns
+	#node start markers (and option words) are forbidden in introns
 	do {
 	  $rval = rand( 2**32 );
-	} while( NetCompiler::_is_node_start( $rval ) );
+	} while( NetCompiler::_is_node_start( $rval ) or
+		 NetCompiler::_is_option_word( $rval ) );
 	push @intarray, $rval;
       }
     }
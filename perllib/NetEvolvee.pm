@@ -29,6 +29,23 @@ Below is an example config file for Evolver, using NetEvolvee methods.
           remove_introns => 0,
           count_partials => 0.15,
           rm_killed => 1,
+          fitness_workers => 4,
+          so_cache => '/var/tmp/neural_so_cache',
+          so_cache_size => 200,
+          batch_compile => 4,
+          net_backend => 'so',
+          net_precision => 'double',
+          net_activation => 'exact',
+          net_fold => 0,
+          keep_weights => 0,
+          train_batch => 0,
+          warm_feedback => 0,
+          train_optimizer => 'none',
+          train_seed => undef,
+          train_budget => 0,
+          train_work_budget => 0,
+          train_replicas => 0,
+          telemetry => 0,
  };
 
 =head1 DESCRIPTION
@@ -43,13 +60,20 @@ This module is not really intended to be used in a script, which explains the un
 
 package NetEvolvee;
 
+use IO::Handle;
+use IPC::Open2;
+use POSIX qw(WNOHANG);
+use JSON::PP;
+
 use NetCompiler;
+use NetEvolvee::CompileCache;
 use Mutation;
-use Utility qw(progress_dots maketemp);
+use Utility qw(progress_dots);
 
 sub _compile_genome_opts {
   my $self = shift;
-  my $project_def = ProjectConfig::get_config( $self->{PROJECT_DIR} );
+  my $proj_dir = @_ ? shift : $self->{PROJECT_DIR};
+  my $project_def = ProjectConfig::get_config( $proj_dir );
   my %opts;
   if( defined $project_def->{introns} ) {
     if( ref( $project_def->{introns} ) eq 'HASH' ) {
@@ -77,8 +101,7 @@ sub load {
   my $nc;
   my $self = bless { PROJECT_DIR => $proj_dir,
 		     FILE => $file_gen,
-		     STEM => $stem,
-		     OBJECT => $obj }, NetEvolvee;
+		     STEM => $stem }, NetEvolvee;
   if( -f $file_gen ) {
     $nc = new NetCompiler( filename => $file_gen, genome_mode => 1 );
     die "error loading network" unless defined $nc;
@@ -89,24 +112,25 @@ sub load {
   } else {
     die "No file exists for net '$id' ($proj_dir)";
   }
+  $self->{OBJECT} = $nc;
   return $self;
 }
 
-=item $net = NetEvolvee->new(object => <obj>, temp => <temp_file>)
+=item $net = NetEvolvee->new(object => <obj>, genome => <genome>)
 
-=item $net = $old_net->new( object => <obj>, temp => <temp_file> )
+=item $net = $old_net->new( object => <obj>, genome => <genome> )
 
-Creates a new NetEvolvee object.  If called as a method of an existing NetEvolvee object (as returned by load()), the location of the project directory will be copied from $old_net to $new_net.  <obj> should be a NetCompiler object, and <temp_file> should be the filename of the network definition (.gen or .net file).
+Creates a new NetEvolvee object.  If called as a method of an existing NetEvolvee object (as returned by load()), the location of the project directory will be copied from $old_net to $new_net.  <obj> should be a NetCompiler object, and <genome> the network's genome, as a string of bytes, which is kept in memory until the network is saved.  For older callers, temp => <temp_file> may give the filename of the network definition (.gen file) instead.
 
 =cut
 
 sub new {
   my $pkg = shift;
   my %args = @_;
-  my $obj = $args{object};
-  my $tmpfile = $args{temp};
 
-  my $self = { OBJECT => $obj, TEMP_FILE => $tmpfile };
+  my $self = { OBJECT => $args{object},
+	       GENOME => $args{genome},
+	       TEMP_FILE => $args{temp} };
   if( ref( $pkg ) ) {
     bless $self, ref( $pkg );
     $self->{PROJECT_DIR} = $pkg->{PROJECT_DIR}
@@ -116,9 +140,26 @@ sub new {
   return $self;
 }
 
+=item $genome = $net->genome
+
+Returns the network's genome as a string of bytes, reading it from its .gen file the first time if it wasn't bred in memory.
+
+=cut
+
+sub genome {
+  my $self = shift;
+  unless( defined $self->{GENOME} ) {
+    my $file = defined( $self->{FILE} ) ? $self->{FILE} : $self->{TEMP_FILE};
+    die "No genome for the network" unless defined $file;
+    $self->{GENOME} = Mutation::read_genome( $file );
+    die "Can't read $file: $!" unless defined $self->{GENOME};
+  }
+  return $self->{GENOME};
+}
+
 =item $net->save( <project_dir>, <net_id> )
 
-Saves the network to <project_dir>/<net_id>.gen.  Sets the project dir and id for the $net object, and removes the temporary file in which the network was previously stored.  If recompile_genome is set to a true value in the project config, the saved genome file is produced by a call to NetCompiler::compile.  Otherwise it is simply copied from the temp file.
+Saves the network to <project_dir>/<net_id>.gen.  Sets the project dir and id for the $net object, and removes the temporary file in which the network was previously stored, if any.  If recompile_genome is set to a true value in the project config, the saved genome file is produced by a call to NetCompiler::compile.  Otherwise the genome is written out as it is, with a single write.
 
 =cut
 
@@ -126,29 +167,58 @@ sub save {
   my $self = shift;
   my $proj_dir = shift;
   my $id = shift;
-  my $netdir = "$proj_dir/networks";
   my $project_def = ProjectConfig::get_config( $proj_dir );
+  my $netdir = "$proj_dir/networks";
   unless( -d $netdir ) {
     mkdir $netdir or die "Can't create $netdir: $!";
   }
-  my $stem = "$netdir/$id";
-  my $file = "$stem.gen";
-  my $genfile = $self->{FILE};
-  $genfile = $self->{TEMP_FILE} unless defined $genfile;
-  if( defined $genfile and -f $genfile and
-      not $project_def->{recompile_genome} ) {
-    system( "cp $genfile $file" );
-    if( defined $self->{TEMP_FILE} and $genfile eq $self->{TEMP_FILE} ) {
-      unlink( $self->{TEMP_FILE} );
-    }
+  $self->_save_genome( $project_def, $proj_dir, "$netdir/$id" );
+}
+
+=item NetEvolvee->save_population( <project_dir>, <net_id> => <net>, ... )
+
+Saves each network as save() would, reading the project config and checking the networks directory only once.  Evolver calls this once per generation with all the new networks, so that breeding (which is done in memory) and saving are kept apart.
+
+=cut
+
+sub save_population {
+  my $pkg = shift;
+  my $proj_dir = shift;
+  my @nets = @_;
+  my $project_def = ProjectConfig::get_config( $proj_dir );
+  my $netdir = "$proj_dir/networks";
+  unless( -d $netdir ) {
+    mkdir $netdir or die "Can't create $netdir: $!";
   }
-  elsif( defined $self->{OBJECT} ) {
-    my $nc = $self->{OBJECT};
-    $nc->compile( 'genome', filename => $file, $self->_compile_genome_opts() );
+  while( my( $id, $net ) = splice( @nets, 0, 2 ) ) {
+    $net->_save_genome( $project_def, $proj_dir, "$netdir/$id" );
   }
-  else {
+  return 1;
+}
+
+sub _save_genome {
+  my $self = shift;
+  my( $project_def, $proj_dir, $stem ) = @_;
+  my $file = "$stem.gen";
+  my $have_genome = ( defined $self->{GENOME} or defined $self->{FILE} or
+		      defined $self->{TEMP_FILE} );
+
+  if( ( $project_def->{recompile_genome} or not $have_genome ) and
+      defined $self->{OBJECT} ) {
+    $self->{OBJECT}->compile( 'genome', filename => $file,
+			      $self->_compile_genome_opts( $proj_dir ) );
+    #the genome is now the recompiled one
+    delete $self->{GENOME};
+  } elsif( $have_genome ) {
+    Mutation::write_genome( $file, $self->genome() )
+      or die "Can't write $file: $!";
+  } else {
     die "No .gen file and no in memory representation.";
   }
+  if( defined $self->{TEMP_FILE} ) {
+    unlink( $self->{TEMP_FILE} );
+    delete $self->{TEMP_FILE};
+  }
   $self->{STEM} = $stem;
   $self->{FILE} = $file;
   $self->{PROJECT_DIR} = $proj_dir;
@@ -162,61 +232,208 @@ Removes the files associate with this network.
 
 sub kill_files {
   my $self = shift;
-  system( "rm $self->{STEM}.*" );
+  unlink( glob( "$self->{STEM}.*" ) );
+}
+
+=item $net->prepare_fitness
+
+Builds the network's shared object (or blob, see below), if it hasn't been built already.  Evolver calls this once per individual before taking its fitness samples, which may then run in parallel.
+
+If the project config sets 'net_backend' to 'blob', networks are not compiled at all: NetCompiler writes the analysed network to a .blob file, which evaluate_server runs with libneural's interpreter.  This skips gcc entirely, which pays off when most networks are only trained briefly; backend_bench compares the two on a given network.  The default, 'so', compiles each network to a shared object.
+
+'net_precision' ('double' or 'float') and 'net_activation' ('exact' or 'fast') pick the variant of the compiled networks (see the precision and activation options to NetCompiler's compile()).  Use src/variant_check on a typical network to see that the faster variant learns the same way before turning it on.  They only apply to the 'so' backend.
+
+'net_fold' compiles the networks with fold (see NetCompiler::C): their fixed weights become constants which aren't trained, and connections fixed at zero, with whatever they alone fed, are left out.  Genomes fix about a quarter of their weights, so this saves a good part of the work of training, but it changes what the fixed weights mean -- they no longer learn -- so fitnesses with and without it aren't comparable.  'so' backend only, like the above.
+
+Compiled objects are kept in a cache (see L<NetEvolvee::CompileCache>) keyed by the generated C code, so a network whose code matches one compiled earlier, by any individual or project, is linked from the cache instead of being compiled again.  The project config may set 'so_cache' to the cache directory (default: so_cache/ in the neural directory), or to 0 to disable the cache, and 'so_cache_size' to its size limit in megabytes (default 200).
+
+=cut
+
+sub prepare_fitness {
+  my $self = shift;
+  return $self->_build_net();
+}
+
+=item NetEvolvee->prepare_population( @nets )
+
+If batch_compile is set in the project config, the networks which need building are compiled together: their code is emitted with a distinct symbol suffix for each network, split into batch_compile translation units, built with a parallel make into one shared object, and each network's .so file is made a hard link to it.  This pays for compiler startup and linking once per generation instead of once per network.  Networks found in the compile cache are fetched from there instead, and any which aren't built here (for instance because the batch failed to compile) are left for prepare_fitness() to build individually.
+
+=cut
+
+sub prepare_population {
+  my $pkg = shift;
+  my @nets = grep { not -f "$_->{STEM}.so" } @_;
+  return 1 unless @nets;
+  my $project_def = ProjectConfig::get_config( $nets[0]->{PROJECT_DIR} );
+  my $units = $project_def->{batch_compile};
+  return 1 unless $units and $nets[0]->_net_backend() eq 'so';
+
+  my @todo;
+  for my $net (@nets) {
+    my $cache = $net->_so_cache();
+    next if( defined $cache and
+	     $cache->fetch( $cache->key( $net->{OBJECT}->compile( 'c', $net->_compile_c_opts() ) ),
+			    "$net->{STEM}.so" ) );
+    push @todo, $net;
+  }
+  return 1 unless @todo > 1;
+  $units = @todo if $units > @todo;
+
+  my $neurodir = $nets[0]->_get_neuro_dir();
+  my $batch = "$nets[0]->{PROJECT_DIR}/networks/batch.$$";
+  my @code;
+  for my $i (0..$#todo) {
+    $code[$i % $units] .= $todo[$i]->{OBJECT}->compile( 'c', symbol_suffix => "_n$i",
+						      $todo[$i]->_compile_c_opts() );
+  }
+  my @objs;
+  for my $u (0..$#code) {
+    open CODE, ">$batch.$u.c" or die "Can't open $batch.$u.c for output: $!";
+    print CODE $code[$u];
+    close CODE;
+    push @objs, "$batch.$u.o";
+  }
+  $ENV{NEURODIR} = $neurodir;
+  system( "gmake -j $units -f $neurodir/perllib/NetEvolvee/evolve_makefile " .
+	  "BATCH_SO=$batch.so BATCH_OBJS='@objs' $batch.so > /dev/null 2>&1" );
+  unlink( (map { "$batch.$_.c" } (0..$#code)), @objs );
+  return 1 unless -f "$batch.so";
+  for my $i (0..$#todo) {
+    my $stem = $todo[$i]->{STEM};
+    next unless link( "$batch.so", "$stem.so" );
+    #test_fitness needs to know which net in the .so is this one
+    open NAME, ">$stem.netname" or die "Can't open $stem.netname: $!";
+    print NAME "n$i\n";
+    close NAME;
+  }
+  unlink( "$batch.so" );
+  return 1;
+}
+
+=item NetEvolvee->prepare_workers( $count, @nets )
+
+=item NetEvolvee->enter_worker( $slot )
+
+Evolver calls prepare_workers() before handing fitness samples to $count forked workers, and each worker calls enter_worker() with its slot (1 to $count).  prepare_workers() makes sure an evaluate_server is running for each slot of each of the networks' projects, starting any which aren't (or have died), and enter_worker() has test_fitness() use its slot's.  As the servers belong to the Evolver process, they outlive the workers, and the next generation's workers use them again.
+
+=cut
+
+#evaluate_server processes, keyed by the pid which started them and the
+#project dir, and for fitness workers' servers the worker slot too; a
+#forked child must not talk over its parent's pipes, other than through
+#its own slot's server
+my %evaluators;
+#[ Evolver pid, slot ] in a fitness worker (see enter_worker)
+my $worker_slot;
+
+sub prepare_workers {
+  my $pkg = shift;
+  my $count = shift;
+  my %projects = map { $_->{PROJECT_DIR} => $_ } @_;
+
+  for my $proj_dir (sort( keys( %projects ) )) {
+    for my $slot (1..$count) {
+      my $key = "$$:$proj_dir:$slot";
+      #a server which died in a worker is left for us to reap
+      if( defined $evaluators{$key} and
+	  waitpid( $evaluators{$key}->{PID}, WNOHANG ) != 0 ) {
+	_close_evaluator( $key );
+      }
+      $projects{$proj_dir}->_start_evaluator( $key )
+	unless defined $evaluators{$key};
+    }
+  }
+  return 1;
+}
+
+sub enter_worker {
+  my $pkg = shift;
+  my $slot = shift;
+  $worker_slot = [ getppid(), $slot ];
+  return 1;
 }
 
 =item $net->test_fitness
 
-Calls the train_and_evaluate utility on the network, using the file 'training' in the network directory.  Calculates a fitness score between 0 and 2500 based on the results given by train_and_evaluate.
+Trains and tests the network with the project's evaluate_server, using the file 'training' in the project directory.  The evaluate_server processes are kept running for the whole run, so no process is started per individual: one per project for the Evolver process itself, and with fitness_workers, one per project for each worker slot (see prepare_workers below), which the Evolver starts and each generation's workers take over.  The training file is read once by each of them.  Calculates a fitness score between 0 and 2500 based on the results it returns.
+
+If keep_weights is set in the project config, the trained weights are saved next to the network as a binary checkpoint, <stem>.weights (see save_weights() in libneural), so a good network can be reloaded with its weights instead of trained again; evaluate_server's load_weights key does that.  The checkpoint goes with the rest of the network's files when it is killed.
+
+train_batch in the project config trains in mini-batches of that many presentations, applying the summed weight changes once per batch (see TRAIN_BATCH in neural.h); 0, the default, updates after every example.
+
+train_optimizer in the project config picks how the weight changes are turned into steps (optimizer=<name>; see TRAIN_OPTIMIZER in neural.h): 'none', the default, applies them as they are; 'momentum' keeps a velocity per weight; 'adaptive' scales each weight's changes by their running size, which usually reaches a learned_fraction of 1 in several times fewer iterations, with or without train_batch; and 'rprop' adapts a step size per weight from the signs of its changes, and is refused without a train_batch as large as the training set.  Momentum steps up to ten times further than plain ones, so it suits small batches, or none.
+
+warm_feedback in the project config starts each feedback relaxation from the previous presentation's state (see TRAIN_WARM_FEEDBACK in neural.h).  Either way, the sweeps each feedback group took come back in the training statistics as feedback_sweeps and feedback_error_sweeps (comma separated, one per group), with feedback_unsettled counting the relaxations cut off by the net's feedback_limit.
+
+train_replicas in the project config trains that many replicas of the network at once, each from its own starting weights, in lock-step over the same examples (replicas=<k>; see train_replicas_r() in libneural).  The training statistics are then the replicas' aggregate, so learned_fraction is their mean, and the test statistics (and the saved weights, with keep_weights) are those of the replica which did best on the test set.  This gives a steadier fitness than one random start, at much less than the cost of as many separate runs.  It can't be combined with train_batch, warm_feedback or train_optimizer.
+
+train_budget and train_work_budget in the project config make training stop after that many presentations, or that much work (presentation_budget and work_budget; see training_statistics.work in neural.h), rather than on evaluate_server's time limit, which is then only a backstop of a minute.  The budgets are per replica with train_replicas.  The bonus for finishing early then goes by the share of the budget left over, rather than by elapsed_seconds.  With train_seed as well, which seeds the starting weights and example order (seed=<n>), every sample of a network's fitness is the same on any machine however busy it is, so average_over can be 1; and as every network starts from the same seed, their fitnesses compare like for like.
+
+evaluate_server is asked for its statistics as JSON (format=json; see fwrite_statistics_json() in libneural), so the training statistics also carry presentations_per_second, allocations, and timings: a hash of the seconds spent in the forward pass, the backward pass, applying weight changes, shuffling, and other.  If telemetry is set in the project config, each reply is also appended as a line to telemetry.jsonl in the project directory, for dashboards to pick up.
 
 =cut
 
 sub test_fitness {
   my $self = shift;
 
-  my $so = $self->{STEM} . ".so";
-  my $neurodir = $self->_get_neuro_dir();
+  my $so = $self->{STEM} . "." . $self->_net_backend();
   my $proj_dir = $self->{PROJECT_DIR};
   my $project_def = ProjectConfig::get_config( $proj_dir );
 
-  my $ok = $self->_build_so();
+  my $ok = $self->_build_net();
 
   #if building the .so fails, fitness is zero
   unless( defined $ok ) {
     return 0;
   }
 
-  open EVAL, "$neurodir/bin/train_and_evaluate $so $proj_dir/training 0.005 |";
-
-  my %data;
-  my $cur;
-  #don't start parsing info until '=====...=====' appears on a line by itself
-  while( my $line = <EVAL> ) {
-    chomp $line;
-    last if $line =~ m|^\={5}\.{3}\={5}$|;
+  my @args;
+  if( open NAME, "<$self->{STEM}.netname" ) {
+    #built by prepare_population along with other nets
+    my $name = <NAME>;
+    close NAME;
+    chomp $name;
+    push @args, "net=$name";
   }
-  while( my $line = <EVAL> ) {
-    chomp $line;
-    if( $line =~ /^(.*)\:\:$/ ) {
-      $cur = {};
-      $data{$1} = $cur;
-    }
-    elsif( $line =~ /^(.*?): (.*)$/ ) {
-      my $k = $1;
-      my $v = $2;
-      $cur->{$k} = $v;
-    }
+  if( $project_def->{train_batch} ) {
+    #mini-batches of this many presentations
+    push @args, "batch=$project_def->{train_batch}";
+  }
+  if( $project_def->{warm_feedback} ) {
+    push @args, "warm_feedback=1";
+  }
+  if( $project_def->{train_optimizer} &&
+      $project_def->{train_optimizer} ne 'none' ) {
+    push @args, "optimizer=$project_def->{train_optimizer}";
+  }
+  if( $project_def->{train_replicas} ) {
+    push @args, "replicas=$project_def->{train_replicas}";
   }
-  close EVAL;
+  if( defined $project_def->{train_seed} ) {
+    push @args, "seed=$project_def->{train_seed}";
+  }
+  my $budgeted = $project_def->{train_budget} ||
+    $project_def->{train_work_budget};
+  if( $budgeted ) {
+    #the budget decides when training stops; the timeout is a backstop
+    push @args, "timeout=60";
+    push @args, "presentation_budget=$project_def->{train_budget}"
+      if $project_def->{train_budget};
+    push @args, "work_budget=$project_def->{train_work_budget}"
+      if $project_def->{train_work_budget};
+  }
+  if( $project_def->{keep_weights} ) {
+    push @args, "save_weights=$self->{STEM}.weights";
+  }
+  my %data = $self->_evaluate( $so, @args );
   unless( defined $data{training_statistics}->{learned_fraction} ) {
     print Data::Dumper::Dumper( \%data );
   }
 
-
   my $fitness = $data{training_statistics}->{learned_fraction} * 1200;
   if( $data{training_statistics}->{learned_fraction} > 0.9999 ) {
     #bonus for finishing early
-    $fitness += (1 - $data{training_statistics}->{elapsed_seconds})*100;
+    $fitness += (1 - $self->_spent( $project_def, \%data ))*100;
     my $test_ok = $data{test_statistics}->{success_rate};
     my $partial_t = 0;
     if( defined $project_def->{count_partials} ) {
@@ -228,9 +445,141 @@ sub test_fitness {
   return $fitness;
 }
 
+#how much of the training budget a run used: the larger share of the
+#presentation and work budgets with either set (at most 1), and elapsed
+#seconds without.  The budgets are each replica's, while the statistics
+#are the replicas' aggregate, so they're shared out first.
+sub _spent {
+  my( $self, $project_def, $data ) = @_;
+  my $train = $data->{training_statistics};
+
+  unless( $project_def->{train_budget} || $project_def->{train_work_budget} ) {
+    return $train->{elapsed_seconds};
+  }
+  my $replicas = $project_def->{train_replicas} || 1;
+  my $spent = 0;
+  if( $project_def->{train_budget} ) {
+    $spent = $train->{presentation_count} / $replicas /
+      $project_def->{train_budget};
+  }
+  if( $project_def->{train_work_budget} ) {
+    my $work = $train->{work} / $replicas / $project_def->{train_work_budget};
+    $spent = $work if $work > $spent;
+  }
+  return $spent > 1 ? 1 : $spent;
+}
+
+sub _evaluator_key {
+  my $proj_dir = shift;
+  return "$$:$proj_dir" unless defined $worker_slot;
+  return "$worker_slot->[0]:$proj_dir:$worker_slot->[1]";
+}
+
+sub _start_evaluator {
+  my $self = shift;
+  my $key = shift;
+  my $proj_dir = $self->{PROJECT_DIR};
+
+  my $neurodir = $self->_get_neuro_dir();
+  my( $from_eval, $to_eval );
+  my $pid = open2( $from_eval, $to_eval, "$neurodir/bin/evaluate_server",
+		   "$proj_dir/training", 0.005 );
+  $evaluators{$key} = { PID => $pid, OUT => $from_eval, IN => $to_eval };
+  return $evaluators{$key};
+}
+
+sub _evaluator {
+  my $self = shift;
+  my $key = _evaluator_key( $self->{PROJECT_DIR} );
+
+  return $evaluators{$key} if defined $evaluators{$key};
+  return $self->_start_evaluator( $key );
+}
+
+sub _close_evaluator {
+  my $key = shift;
+  my $ev = $evaluators{$key};
+  return unless defined $ev;
+  close $ev->{IN};
+  close $ev->{OUT};
+  waitpid( $ev->{PID}, 0 );
+  delete $evaluators{$key};
+}
+
+END {
+  for my $key (keys( %evaluators )) {
+    _close_evaluator( $key ) if $key =~ /^$$:/;
+  }
+}
+
+#sends one request to the evaluator, and returns the results in the form
+#( training_statistics => { ... }, test_statistics => { ... } )
+sub _evaluate {
+  my $self = shift;
+  my $so = shift;
+  my @args = @_;
+
+  #a crashed server shows up as EOF below, rather than killing us here
+  local $SIG{PIPE} = 'IGNORE';
+  my $ev = $self->_evaluator();
+  my $fh = $ev->{IN};
+  print $fh join( " ", $so, @args, "format=json" ), "\n";
+  $fh->flush();
+  my $reply = readline( $ev->{OUT} );
+  unless( defined $reply ) {
+    #the net probably crashed the server, so it gets a zero; the next
+    #request will start a fresh one
+    print STDERR "evaluate_server exited while testing $so\n";
+    _close_evaluator( _evaluator_key( $self->{PROJECT_DIR} ) );
+    return ();
+  }
+  chomp $reply;
+  if( $reply =~ /^error (.*)$/ ) {
+    print STDERR "evaluate_server: $1\n";
+    return ();
+  }
+  return () unless $reply =~ /^ok (.*)$/;
+  my $json = $1;
+  my $stats = eval { decode_json( $json ) };
+  unless( defined $stats ) {
+    print STDERR "evaluate_server: bad reply for $so: $@";
+    return ();
+  }
+  if( ProjectConfig::get_config( $self->{PROJECT_DIR} )->{telemetry} ) {
+    $self->_log_telemetry( $json );
+  }
+  my %data = ( training_statistics => $stats->{training_statistics},
+	       test_statistics => $stats->{test_statistics} );
+  #as the text replies had them
+  my $train = $data{training_statistics};
+  my $feedback = delete $train->{feedback};
+  if( $stats->{info}->{feedback_groups} ) {
+    $train->{feedback_sweeps} = join( ",", @{$feedback->{sweeps}} );
+    $train->{feedback_error_sweeps} = join( ",", @{$feedback->{error_sweeps}} );
+    $train->{feedback_unsettled} = $feedback->{unsettled};
+  }
+  return %data;
+}
+
+#appends an evaluate_server reply to the project's telemetry.jsonl; the
+#"net" field names the network
+sub _log_telemetry {
+  my $self = shift;
+  my $json = shift;
+
+  my $log = "$self->{PROJECT_DIR}/telemetry.jsonl";
+  if( open TELEMETRY, ">>$log" ) {
+    #one write per line, so concurrent fitness workers don't interleave
+    syswrite TELEMETRY, "$json\n";
+    close TELEMETRY;
+  } else {
+    print STDERR "can't append to $log: $!\n";
+  }
+}
+
 =item $net->breed( <mutation_level>, [ <mate> ] );
 
-If <mate> is supplied (it should be a NetEvolvee object), calls Mutation::cross_genomes() on the genome files of it and $net.  Either the result of the cross, or the genome of $net is then subject to Mutation::mutate_genome().  If remove_introns is set to a true value in the project config, the network is then processed by Mutation::purge_introns().
+If <mate> is supplied (it should be a NetEvolvee object), its genome and that of $net are crossed with Mutation::cross_genome_buffers().  Either the result of the cross, or the genome of $net is then subject to Mutation::mutate_genome_buffer().  If remove_introns is set to a true value in the project config, the network is then processed by Mutation::purge_introns_buffer().  All of this happens in memory, as does the child's NetCompiler load; nothing is written until the child is saved.
 
 =cut
 
@@ -240,44 +589,100 @@ sub breed {
   my @spouses = @_;
   my $project_def = ProjectConfig::get_config( $self->{PROJECT_DIR} );
 
-  die "Can't breed unless saved!" unless -f $self->{FILE};
-
-  my $f_in;
-  my @rm_files;
+  my $genome = $self->genome();
   if( @spouses > 1 ) {
     die "only 2 networks can mate at a time!";
   } elsif( @spouses == 1 ) {
-    my $f1 = $self->{FILE};
-    my $f2 = $spouses[0]->{FILE};
-
-    my $f_cross = maketemp();
-    chomp $f_cross;
     #should die on error
-    Mutation::cross_genomes( $f1, $f2, $f_cross );
-    $f_in = $f_cross;
-    push @rm_files, $f_cross;
-  }
-  if( not @spouses ) {
-    $f_in = $self->{FILE};
+    $genome = Mutation::cross_genome_buffers( $genome, $spouses[0]->genome() );
   }
   #always mutate:
-  my $f_out = maketemp();
-  chomp $f_out;
-  Mutation::mutate_genome( $f_in, $f_out, $mutation_level );
+  $genome = Mutation::mutate_genome_buffer( $genome, $mutation_level );
   if( $project_def->{remove_introns} ) {
-    my $f_muta = $f_out;
-    $f_out = maketemp();
-    chomp $f_out;
-    push @rm_files, $f_muta;
-    Mutation::purge_introns( $f_muta, $f_out );
+    $genome = Mutation::purge_introns_buffer( $genome );
   }
-  my $new_nc = new NetCompiler( genome_mode => 1, filename => $f_out );
+  my $new_nc = new NetCompiler( genome_mode => 1, data => \$genome );
   die "Can't create child" unless( defined $new_nc );
-  unlink( @rm_files );
-  return ( $self->new( object => $new_nc, temp => $f_out ) );
+  return ( $self->new( object => $new_nc, genome => $genome ) );
 }
 
 
+#compile caches, keyed by directory
+my %so_caches;
+
+#returns the project's NetEvolvee::CompileCache, or undef if so_cache is 0
+sub _so_cache {
+  my $self = shift;
+  my $project_def = ProjectConfig::get_config( $self->{PROJECT_DIR} );
+  my $neurodir = $self->_get_neuro_dir();
+
+  my $dir = $project_def->{so_cache};
+  $dir = "$neurodir/so_cache" unless defined $dir;
+  return undef unless $dir;
+  unless( defined $so_caches{$dir} ) {
+    #anything besides the code which changes the object goes in the salt:
+    my $salt = "";
+    for my $f ("$neurodir/perllib/NetEvolvee/evolve_makefile",
+	       "$neurodir/include/neural.h") {
+      local $/ = undef;
+      open SALT, "<$f" or next;
+      $salt .= <SALT>;
+      close SALT;
+    }
+    my $cc = defined( $ENV{CC} ) ? $ENV{CC} : 'cc';
+    $salt .= join( "\0", $cc, `$cc -dumpversion 2>/dev/null`,
+		   map { defined($_) ? $_ : "" } @ENV{qw(CFLAGS LDFLAGS)} );
+    my $limit = $project_def->{so_cache_size};
+    $limit = 200 unless defined $limit;
+    $so_caches{$dir} = NetEvolvee::CompileCache->new
+      ( dir => $dir, limit => $limit * 1024 * 1024, salt => $salt );
+    warn "can't create so_cache $dir: $!" unless defined $so_caches{$dir};
+  }
+  return $so_caches{$dir};
+}
+
+#'so' or 'blob' -- also the extension of the built net's file
+sub _net_backend {
+  my $self = shift;
+  my $project_def = ProjectConfig::get_config( $self->{PROJECT_DIR} );
+  my $backend = $project_def->{net_backend};
+  return 'so' unless defined $backend;
+  die "unknown net_backend '$backend'" unless $backend =~ /^(so|blob)$/;
+  return $backend;
+}
+
+#precision, activation and fold options for NetCompiler::C
+sub _compile_c_opts {
+  my $self = shift;
+  my $project_def = ProjectConfig::get_config( $self->{PROJECT_DIR} );
+  my %opts;
+  $opts{precision} = $project_def->{net_precision}
+    if defined $project_def->{net_precision};
+  $opts{activation} = $project_def->{net_activation}
+    if defined $project_def->{net_activation};
+  $opts{fold} = 1 if $project_def->{net_fold};
+  return %opts;
+}
+
+sub _build_net {
+  my $self = shift;
+  if( $self->_net_backend() eq 'blob' ) {
+    return $self->_build_blob();
+  }
+  return $self->_build_so();
+}
+
+sub _build_blob {
+  my $self = shift;
+  my $blob = "$self->{STEM}.blob";
+
+  return 1 if -f $blob;
+  #write to a temp name, so a half-written blob is never evaluated
+  $self->{OBJECT}->compile( 'blob', filename => "$blob.$$" );
+  rename( "$blob.$$", $blob ) or return undef;
+  return 1;
+}
+
 sub _build_so {
   my $self = shift;
 
@@ -290,7 +695,19 @@ sub _build_so {
   }
 
   #make the c code:
-  $nc->compile( 'c', filename => $c );
+  my $code = $nc->compile( 'c', $self->_compile_c_opts() );
+
+  #identical code may well have been compiled already
+  my $cache = $self->_so_cache();
+  my $key;
+  if( defined $cache ) {
+    $key = $cache->key( $code );
+    return 1 if $cache->fetch( $key, "$stem.so" );
+  }
+
+  open CODE, ">$c" or die "Can't open $c for output: $!";
+  print CODE $code;
+  close CODE;
 
   #compile it
   my $neurodir = $self->_get_neuro_dir();
@@ -298,6 +715,7 @@ sub _build_so {
   system( "gmake -f $neurodir/perllib/NetEvolvee/evolve_makefile $stem.so > /dev/null 2>&1" );
   unlink( $c );
   if( -f "$stem.so" ) {
+    $cache->store( $key, "$stem.so" ) if defined $cache;
     return 1;
   } else {
     return undef;
@@ -0,0 +1,152 @@
+=head1 NAME
+
+NetEvolvee::CompileCache - a content-addressed store of compiled network shared objects.
+
+=head1 SYNOPSIS
+
+ use NetEvolvee::CompileCache;
+
+ $cache = NetEvolvee::CompileCache->new( dir => "$neurodir/so_cache",
+                                         limit => 200 * 1024 * 1024,
+                                         salt => $makefile_text );
+ $key = $cache->key( $c_code );
+ unless( $cache->fetch( $key, "$stem.so" ) ) {
+   #...build $stem.so...
+   $cache->store( $key, "$stem.so" );
+ }
+
+=head1 DESCRIPTION
+
+Mutation and crossover often produce a genome whose generated C is identical to that of a network which has already been compiled.  The cache keeps one copy of each shared object, named by the MD5 of the generated code plus a salt (the compiler, flags, makefile and so on), so that gcc only runs once for each distinct piece of code, across individuals, generations and projects.
+
+Entries are installed and handed out as hard links (falling back to a copy when the cache is on another filesystem), so deleting an individual's files never disturbs the cache, and vice versa.  New entries are written under a temporary name and renamed into place, so several processes may share a cache directory.  When the total size of the cache passes its limit, the least recently used entries are removed.
+
+=head1 INTERFACE
+
+=over
+
+=cut
+
+package NetEvolvee::CompileCache;
+
+use Digest::MD5 qw(md5_hex);
+use File::Copy qw(copy);
+
+=item $cache = NetEvolvee::CompileCache->new( dir => <dir> [, limit => <bytes>] [, salt => <string>] )
+
+Creates the cache object, and <dir> if it doesn't exist.  <limit> is the size in bytes beyond which old entries are evicted (default 200MB).  <salt> is mixed into every key; it should contain anything other than the code which affects the compiled object.  Returns undef if <dir> can't be created.
+
+=cut
+
+sub new {
+  my $pkg = shift;
+  my %args = @_;
+
+  my $dir = $args{dir};
+  unless( -d $dir ) {
+    mkdir $dir or return undef;
+  }
+  my $self = { DIR => $dir,
+	       LIMIT => (defined $args{limit}) ? $args{limit} : 200*1024*1024,
+	       SALT => (defined $args{salt}) ? $args{salt} : "",
+	     };
+  return bless $self, $pkg;
+}
+
+=item $key = $cache->key( <code> )
+
+Returns the cache key for the generated code <code>.
+
+=cut
+
+sub key {
+  my $self = shift;
+  my $code = shift;
+  return md5_hex( $self->{SALT}, "\0", $code );
+}
+
+sub _entry {
+  my $self = shift;
+  my $key = shift;
+  return "$self->{DIR}/$key.so";
+}
+
+sub _link_or_copy {
+  my $from = shift;
+  my $to = shift;
+  return 1 if link( $from, $to );
+  return copy( $from, $to );
+}
+
+=item $cache->fetch( <key>, <so_file> )
+
+If an object is stored under <key>, installs it as <so_file> and returns true.  Otherwise returns false.
+
+=cut
+
+sub fetch {
+  my $self = shift;
+  my $key = shift;
+  my $so = shift;
+  my $entry = $self->_entry( $key );
+
+  return 0 unless -f $entry;
+  unlink( $so );
+  return 0 unless _link_or_copy( $entry, $so );
+  #the mtime is the entry's last use, for eviction
+  my $now = time();
+  utime( $now, $now, $entry );
+  return 1;
+}
+
+=item $cache->store( <key>, <so_file> )
+
+Adds the freshly built <so_file> to the cache under <key>, then evicts old entries if the cache is over its limit.
+
+=cut
+
+sub store {
+  my $self = shift;
+  my $key = shift;
+  my $so = shift;
+  my $entry = $self->_entry( $key );
+  my $tmp = "$entry.$$.tmp";
+
+  return unless _link_or_copy( $so, $tmp );
+  unless( rename( $tmp, $entry ) ) {
+    unlink( $tmp );
+    return;
+  }
+  $self->_evict();
+}
+
+sub _evict {
+  my $self = shift;
+  my $dir = $self->{DIR};
+
+  opendir CACHE, $dir or return;
+  my @entries;
+  my $total = 0;
+  for my $f (readdir( CACHE )) {
+    next unless $f =~ /^[0-9a-f]{32}\.so$/;
+    my @st = stat( "$dir/$f" );
+    next unless @st;
+    push @entries, { FILE => "$dir/$f", SIZE => $st[7], MTIME => $st[9] };
+    $total += $st[7];
+  }
+  closedir CACHE;
+  return if $total <= $self->{LIMIT};
+
+  #oldest first; trim to 90% of the limit so we don't evict on every store
+  for my $e (sort { $a->{MTIME} <=> $b->{MTIME} } @entries) {
+    last if $total <= $self->{LIMIT} * 0.9;
+    unlink( $e->{FILE} ) and $total -= $e->{SIZE};
+  }
+}
+
+=back
+
+=cut
+
+1;
+#end
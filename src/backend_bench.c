@@ -0,0 +1,235 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "neural.h"
+
+/* Runs the same network as a compiled SO and as a blob (see
+   NetCompiler::Blob) side by side: checks that both give bit-identical
+   results from the same starting weights, and times loading, forward
+   passes (one at a time, and batched with calc_net_batch) and training
+   for each.  Batched outputs are checked against the unbatched ones.
+
+   usage: backend_bench <network.so> <network.blob> <training_file> <passes>
+
+   Exits with status 1 if the two backends disagree. */
+
+#define LOADS 200
+
+double seconds_since( struct timeval *start ) {
+  struct timeval now;
+  gettimeofday( &now, NULL );
+  return (double)( now.tv_sec - start->tv_sec ) +
+    (double)( now.tv_usec - start->tv_usec ) / 1000000;
+}
+
+typedef struct _backend_STRUCT {
+  const char *name;
+  const char *fname;
+  net_definition net;
+  net_weights wght;
+  net_weights changes;
+  net_io state;
+  double load_secs, calc_secs, batch_secs, train_secs;
+} backend;
+
+int setup_backend( backend *b, unsigned int seed ) {
+  neural_context ctx;
+  struct timeval start;
+  net_definition tmp;
+  int i;
+
+  gettimeofday( &start, NULL );
+  for( i = 0; i < LOADS; i++ ) {
+    if( 0 > load_net( b->fname, &tmp ) ) {
+      return -1;
+    }
+    unload_net( &tmp );
+  }
+  b->load_secs = seconds_since( &start ) / LOADS;
+
+  if( 0 > load_net( b->fname, &b->net ) ) {
+    return -1;
+  }
+  init_neural_context( &ctx, seed );
+  if( 0 > starting_weights_r( &ctx, &b->net, &b->wght ) ) {
+    return -1;
+  }
+  free_neural_context( &ctx );
+  if( 0 > init_net_weights( &b->net, &b->changes ) ||
+      0 > init_net_io( &b->net, &b->state, 1 ) ) {
+    return -1;
+  }
+  return 0;
+}
+
+//one forward pass over the set
+void forward_pass( backend *b, net_io **set, int set_size ) {
+  int i;
+  struct timeval start;
+
+  gettimeofday( &start, NULL );
+  for( i = 0; i < set_size; i++ ) {
+    copy_net_io( &b->state, set[i], COPY_INPUT );
+    calc_net( &b->net, &b->state, &b->wght );
+  }
+  b->calc_secs += seconds_since( &start );
+}
+
+//runs both nets over the set; returns the number of examples on which any
+//node value differs
+int compare_pass( backend *a, backend *b, net_io **set, int set_size ) {
+  int i, mismatches = 0;
+
+  for( i = 0; i < set_size; i++ ) {
+    copy_net_io( &a->state, set[i], COPY_INPUT );
+    copy_net_io( &b->state, set[i], COPY_INPUT );
+    if( 0 > calc_net( &a->net, &a->state, &a->wght ) ||
+	0 > calc_net( &b->net, &b->state, &b->wght ) ||
+	memcmp( a->state.node_values, b->state.node_values,
+		sizeof( double ) * a->state.node_count ) ) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+//one pass over the set with calc_net_batch(); returns the number of
+//examples whose outputs differ from calc_net()'s
+int batch_pass( backend *b, net_io **set, int set_size ) {
+  int in[NEURAL_BATCH_SIZE * b->state.input_count];
+  int out[NEURAL_BATCH_SIZE * b->state.output_count];
+  int base, n, i, j, mismatches = 0;
+  struct timeval start;
+  double secs = 0;
+
+  for( base = 0; base < set_size; base += n ) {
+    n = set_size - base;
+    if( n > NEURAL_BATCH_SIZE ) {
+      n = NEURAL_BATCH_SIZE;
+    }
+    for( i = 0; i < n; i++ ) {
+      for( j = 0; j < b->state.input_count; j++ ) {
+	in[j * n + i] = set[base + i]->inputs[j];
+      }
+    }
+    gettimeofday( &start, NULL );
+    calc_net_batch( &b->net, in, out, n, &b->wght );
+    secs += seconds_since( &start );
+    for( i = 0; i < n; i++ ) {
+      copy_net_io( &b->state, set[base + i], COPY_INPUT );
+      calc_net( &b->net, &b->state, &b->wght );
+      for( j = 0; j < b->state.output_count; j++ ) {
+	if( out[j * n + i] != b->state.outputs[j] ) {
+	  mismatches++;
+	  break;
+	}
+      }
+    }
+  }
+  b->batch_secs += secs;
+  return mismatches;
+}
+
+void train_pass( backend *b, net_io **set, int set_size ) {
+  int i;
+  struct timeval start;
+
+  gettimeofday( &start, NULL );
+  for( i = 0; i < set_size; i++ ) {
+    copy_net_io( &b->state, set[i], COPY_INPUT );
+    calc_net( &b->net, &b->state, &b->wght );
+    copy_net_io( &b->state, set[i], COPY_OUTPUT );
+    train_net( &b->net, &b->state, &b->wght, &b->changes, 0.1,
+	       NET_CORRECT_OUTPUTS_GIVEN | NET_APPLY_WEIGHT_CHANGES );
+  }
+  b->train_secs += seconds_since( &start );
+}
+
+void report( backend *b, int set_size, int passes ) {
+  printf( "%s: load %.1f us, calc %.3f us/example, batch %.3f us/example, "
+	  "train %.3f us/example\n",
+	  b->name, b->load_secs * 1e6,
+	  b->calc_secs * 1e6 / ( (double)set_size * passes ),
+	  b->batch_secs * 1e6 / ( (double)set_size * passes ),
+	  b->train_secs * 1e6 / ( (double)set_size * passes ) );
+}
+
+int main( int argc, char *argv[] ) {
+  backend so, blob;
+  net_io **training_set;
+  net_io *training_buf;
+  int training_set_size;
+  int passes, p, mismatches = 0;
+  unsigned int seed = 1;
+  FILE *trainf;
+
+  if( argc < 5 ) {
+    fprintf( stderr, "Usage: %s <network.so> <network.blob> <training_file> <passes>\n",
+	     argv[0] );
+    exit( -1 );
+  }
+  memset( (void *)&so, 0, sizeof( backend ) );
+  memset( (void *)&blob, 0, sizeof( backend ) );
+  so.name = "compiled";
+  so.fname = argv[1];
+  blob.name = "blob";
+  blob.fname = argv[2];
+  passes = atoi( argv[4] );
+
+  if( 0 > setup_backend( &so, seed ) || 0 > setup_backend( &blob, seed ) ) {
+    fprintf( stderr, "%s: can't initialize neural network: %s\n",
+	     argv[0], neural_error() );
+    exit( -1 );
+  }
+  if( memcmp( &so.net.info, &blob.net.info, sizeof( struct net_info ) ) ) {
+    fprintf( stderr, "%s: the SO and blob are different nets\n", argv[0] );
+    exit( 1 );
+  }
+  if( memcmp( so.wght.weights, blob.wght.weights,
+	      sizeof( double ) * so.wght.weight_count ) ) {
+    printf( "starting weights differ\n" );
+    mismatches++;
+  }
+
+  trainf = fopen( argv[3], "r" );
+  if( trainf == NULL ) {
+    fprintf( stderr, "%s: can't open training file %s: %s\n",
+	     argv[0], argv[3], strerror( errno ) );
+    exit( -1 );
+  }
+  if( 0 > fread_net_io_set( trainf, &training_buf, &training_set,
+			    &training_set_size, &so.net, 0 ) ) {
+    fprintf( stderr, "%s: can't load training set: %s\n",
+	     argv[0], neural_error() );
+    exit( -1 );
+  }
+  fclose( trainf );
+
+  for( p = 0; p < passes; p++ ) {
+    forward_pass( &so, training_set, training_set_size );
+    forward_pass( &blob, training_set, training_set_size );
+    mismatches += batch_pass( &so, training_set, training_set_size );
+    mismatches += batch_pass( &blob, training_set, training_set_size );
+  }
+  //training passes; every node value and weight must stay identical
+  for( p = 0; p < passes; p++ ) {
+    mismatches += compare_pass( &so, &blob, training_set, training_set_size );
+    train_pass( &so, training_set, training_set_size );
+    train_pass( &blob, training_set, training_set_size );
+  }
+  if( memcmp( so.wght.weights, blob.wght.weights,
+	      sizeof( double ) * so.wght.weight_count ) ) {
+    printf( "trained weights differ\n" );
+    mismatches++;
+  }
+
+  report( &so, training_set_size, passes );
+  report( &blob, training_set_size, passes );
+  printf( "%s\n", mismatches ? "MISMATCH" : "results identical" );
+  unload_net( &so.net );
+  unload_net( &blob.net );
+  return mismatches ? 1 : 0;
+}
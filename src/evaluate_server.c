@@ -0,0 +1,409 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "neural.h"
+
+/* Long-lived counterpart to train_and_evaluate: the training file is read
+   once, then network SOs are evaluated one per line read from stdin.
+
+   request:  <network.so> [<key>=<value> ...]
+   keys:     timeout=<seconds>
+	     seed=<n>    reseed the RNG used for starting weights and
+			 example order, to repeat a run exactly
+	     net=<name>  evaluate the net compiled into the SO with
+			 symbols suffixed _<name> (see load_named_net)
+	     save_weights=<file>
+			 write the trained weights to a checkpoint
+	     load_weights=<file>
+			 don't train; test with the checkpoint's weights
+			 (the training fields are then all 0)
+	     batch=<n>   train in mini-batches of n presentations
+			 (see TRAIN_BATCH in neural.h)
+	     warm_feedback=1
+			 warm-start feedback relaxations from the previous
+			 presentation (see TRAIN_WARM_FEEDBACK)
+	     optimizer=<momentum|rprop|adaptive|none>
+			 train with that optimizer (see TRAIN_OPTIMIZER);
+			 rprop needs a batch of the whole training set
+	     presentation_budget=<n>
+	     work_budget=<n>
+			 stop training after n presentations, or n work
+			 (see training_statistics.work), as well as at the
+			 timeout; with seed, the run then repeats exactly
+			 on any machine
+	     format=json answer with the statistics as JSON, including
+			 per-phase timings (see fwrite_statistics_json)
+	     replicas=<k>
+			 train k (at most 1024) replicas in lock-step
+			 (train_replicas_r), and test and save the one
+			 best on the test set; the training fields are
+			 the replicas' aggregate.  Not with batch,
+			 warm_feedback or optimizer
+
+   Each request is answered with exactly one line on stdout, either
+     ok <field>=<value> ...
+   with the training_statistics and test_statistics fields, or
+     error <message>
+   For a net with feedback groups, feedback_sweeps and feedback_error_sweeps
+   list the sweeps each group took while training, comma separated.
+   With format=json the fields follow "ok " as a single JSON object instead.
+*/
+
+#define LINE_MAX_LEN 4096
+//the most replicas= a request may ask for
+#define MAX_REPLICAS 1024
+
+typedef struct _eval_request_STRUCT {
+  char *net_fname;
+  char *net_name;
+  char *save_weights;
+  char *load_weights;
+  int batch;
+  int warm_feedback;
+  int optimizer;
+  int json;
+  int replicas;
+  double timeout_secs;
+  long presentation_budget;
+  double work_budget;
+  int reseed;
+  unsigned int seed;
+} eval_request;
+
+typedef struct _eval_sets_STRUCT {
+  const char *training_fname;
+  int loaded;
+  struct net_info info;
+  net_io_set training, test;
+} eval_sets;
+
+//splits line into the request fields; returns -1 on a malformed line
+int parse_request( char *line, eval_request *req, char *err, size_t errlen ) {
+  char *tok, *val;
+
+  req->net_fname = strtok( line, " \t\r\n" );
+  if( req->net_fname == NULL ) {
+    snprintf( err, errlen, "empty request" );
+    return -1;
+  }
+  while( (tok = strtok( NULL, " \t\r\n" )) != NULL ) {
+    val = strchr( tok, '=' );
+    if( val == NULL ) {
+      snprintf( err, errlen, "expected key=value, got '%s'", tok );
+      return -1;
+    }
+    *val++ = '\0';
+    if( 0 == strcmp( tok, "timeout" ) ) {
+      req->timeout_secs = atof( val );
+    } else if( 0 == strcmp( tok, "seed" ) ) {
+      req->seed = (unsigned int)strtoul( val, NULL, 10 );
+      req->reseed = 1;
+    } else if( 0 == strcmp( tok, "net" ) ) {
+      req->net_name = val;
+    } else if( 0 == strcmp( tok, "batch" ) ) {
+      req->batch = atoi( val );
+      if( req->batch < 0 ) {
+	snprintf( err, errlen, "batch must not be negative" );
+	return -1;
+      }
+    } else if( 0 == strcmp( tok, "warm_feedback" ) ) {
+      req->warm_feedback = atoi( val );
+    } else if( 0 == strcmp( tok, "presentation_budget" ) ) {
+      req->presentation_budget = atol( val );
+      if( req->presentation_budget < 0 ) {
+	snprintf( err, errlen, "presentation_budget must not be negative" );
+	return -1;
+      }
+    } else if( 0 == strcmp( tok, "work_budget" ) ) {
+      req->work_budget = atof( val );
+      if( req->work_budget < 0 ) {
+	snprintf( err, errlen, "work_budget must not be negative" );
+	return -1;
+      }
+    } else if( 0 == strcmp( tok, "optimizer" ) ) {
+      req->optimizer = net_optimizer_kind( val );
+      if( req->optimizer < 0 ) {
+	snprintf( err, errlen, "unknown optimizer '%s'", val );
+	return -1;
+      }
+    } else if( 0 == strcmp( tok, "format" ) ) {
+      if( 0 == strcmp( val, "json" ) ) {
+	req->json = 1;
+      } else if( 0 != strcmp( val, "text" ) ) {
+	snprintf( err, errlen, "unknown format '%s'", val );
+	return -1;
+      }
+    } else if( 0 == strcmp( tok, "replicas" ) ) {
+      req->replicas = atoi( val );
+      if( req->replicas < 0 || req->replicas > MAX_REPLICAS ) {
+	snprintf( err, errlen, "replicas must be from 0 to %d",
+		  MAX_REPLICAS );
+	return -1;
+      }
+    } else if( 0 == strcmp( tok, "save_weights" ) ) {
+      req->save_weights = val;
+    } else if( 0 == strcmp( tok, "load_weights" ) ) {
+      req->load_weights = val;
+    } else {
+      snprintf( err, errlen, "unknown request key '%s'", tok );
+      return -1;
+    }
+  }
+  if( req->replicas && ( req->batch || req->warm_feedback ||
+			 req->optimizer ) ) {
+    snprintf( err, errlen, "replicas can't be combined with batch, "
+	      "warm_feedback or optimizer" );
+    return -1;
+  }
+  return 0;
+}
+
+//the sets are read with the first net's definition; every later net must
+//have the same input/output counts
+int load_sets( eval_sets *sets, net_definition *net,
+	       char *err, size_t errlen ) {
+  net_io_set loaded[2];
+
+  if( sets->loaded ) {
+    if( sets->info.input_count != net->info.input_count ||
+	sets->info.output_count != net->info.output_count ) {
+      snprintf( err, errlen, "net has %d in/%d out, training set has %d/%d",
+		net->info.input_count, net->info.output_count,
+		sets->info.input_count, sets->info.output_count );
+      return -1;
+    }
+    return 0;
+  }
+
+  //text or binary (make_binary_set.pl) sets; training, then test
+  if( 0 > load_io_sets( sets->training_fname, loaded, 2, net, 0 ) ) {
+    snprintf( err, errlen, "can't load training/test set: %s",
+	      neural_error() );
+    return -1;
+  }
+  sets->training = loaded[0];
+  sets->test = loaded[1];
+  sets->info = net->info;
+  sets->loaded = 1;
+  return 0;
+}
+
+void print_sweeps( const char *name, long *sweeps, int groups ) {
+  int i;
+
+  if( groups > NET_FEEDBACK_STATS ) {
+    groups = NET_FEEDBACK_STATS;
+  }
+  for( i = 0; i < groups; i++ ) {
+    printf( "%s%ld", i ? "," : name, sweeps[i] );
+  }
+}
+
+void print_result( struct net_info *info, training_statistics *train_stats,
+		   test_statistics *test_stats ) {
+  printf( "ok" );
+  printf( " iteration_count=%d", train_stats->iteration_count );
+  printf( " presentation_count=%d", train_stats->presentation_count );
+  printf( " training_count=%d", train_stats->training_count );
+  printf( " correct_count=%d", train_stats->correct_count );
+  printf( " learned_count=%d", train_stats->learned_count );
+  printf( " elapsed_seconds=%f", train_stats->elapsed_seconds );
+  printf( " correct_rate=%f", train_stats->correct_rate );
+  printf( " learned_fraction=%f", train_stats->learned_fraction );
+  printf( " update_count=%d", train_stats->update_count );
+  printf( " work=%.0f", train_stats->work );
+  if( info->feedback_groups ) {
+    print_sweeps( " feedback_sweeps=", train_stats->feedback.sweeps,
+		  info->feedback_groups );
+    print_sweeps( " feedback_error_sweeps=",
+		  train_stats->feedback.error_sweeps, info->feedback_groups );
+    printf( " feedback_unsettled=%ld", train_stats->feedback.unsettled );
+  }
+  printf( " successful_items=%d", test_stats->successful_items );
+  printf( " success_rate=%f", test_stats->success_rate );
+  printf( " partial_success_avg=%f", test_stats->partial_success_avg );
+  printf( "\n" );
+}
+
+/* trains req->replicas replicas, and leaves the one which does best on
+   the test set in wght */
+int train_best_replica( neural_context *ctx, eval_sets *sets,
+			net_definition *net, eval_request *req,
+			net_weights *wght, training_statistics *train_stats,
+			char *err, size_t errlen ) {
+  net_replicas reps;
+  training_statistics *per;
+  test_statistics cur, best;
+  int r, best_replica = -1;
+
+  memset( (void *)wght, 0, sizeof( net_weights ) );
+  per = (training_statistics *)calloc( req->replicas,
+				       sizeof( training_statistics ) );
+  if( !per ) {
+    snprintf( err, errlen, "can't allocate statistics for %d replicas",
+	      req->replicas );
+    return -1;
+  }
+  if( 0 > init_net_replicas( net, &reps, req->replicas ) ) {
+    snprintf( err, errlen, "%s", neural_error() );
+    free( per );
+    return -1;
+  }
+  if( 0 > train_replicas_r( ctx, net, sets->training.ptrs,
+			    sets->training.count, &reps, 0.1,
+			    req->timeout_secs, per, train_stats, 0 ) ) {
+    snprintf( err, errlen, "%s", neural_context_error( ctx ) );
+    free_net_replicas( &reps );
+    free( per );
+    return -1;
+  }
+  free( per );
+  for( r = 0; r < req->replicas; r++ ) {
+    if( 0 > get_replica_weights( net, &reps, r, wght ) ) {
+      snprintf( err, errlen, "%s", neural_error() );
+      free_net_replicas( &reps );
+      return -1;
+    }
+    if( 0 > test_on_set_r( ctx, net, sets->test.ptrs, sets->test.count,
+			   wght, &cur, 0 ) ) {
+      snprintf( err, errlen, "%s", neural_context_error( ctx ) );
+      free_net_replicas( &reps );
+      return -1;
+    }
+    if( best_replica < 0 || cur.successful_items > best.successful_items ||
+	( cur.successful_items == best.successful_items &&
+	  cur.partial_success_avg > best.partial_success_avg ) ) {
+      best_replica = r;
+      best = cur;
+    }
+  }
+  get_replica_weights( net, &reps, best_replica, wght );
+  free_net_replicas( &reps );
+  return 0;
+}
+
+int evaluate( neural_context *ctx, eval_sets *sets, eval_request *req,
+	      char *err, size_t errlen ) {
+  net_definition net;
+  net_weights wght;
+  training_statistics train_stats;
+  test_statistics test_stats;
+
+  //every path frees wght, whether or not training got as far as it
+  memset( (void *)&wght, 0, sizeof( net_weights ) );
+  if( 0 > load_named_net( req->net_fname, req->net_name, &net ) ) {
+    snprintf( err, errlen, "can't initialize neural network: %s",
+	      neural_error() );
+    return -1;
+  }
+  if( 0 > load_sets( sets, &net, err, errlen ) ) {
+    unload_net( &net );
+    return -1;
+  }
+
+  if( req->reseed ) {
+    ctx->rng_state = req->seed;
+  }
+  ctx->presentation_budget = req->presentation_budget;
+  ctx->work_budget = req->work_budget;
+  if( req->load_weights ) {
+    memset( (void *)&train_stats, 0, sizeof( training_statistics ) );
+    if( 0 > load_weights( req->load_weights, &net, &wght ) ) {
+      snprintf( err, errlen, "%s", neural_error() );
+      free_net_weights( &wght );
+      unload_net( &net );
+      return -1;
+    }
+  } else if( req->replicas ) {
+    if( 0 > train_best_replica( ctx, sets, &net, req, &wght, &train_stats,
+				err, errlen ) ) {
+      free_net_weights( &wght );
+      unload_net( &net );
+      return -1;
+    }
+  } else if( 0 > train_on_set_r( ctx, &net, sets->training.ptrs,
+				 sets->training.count, &wght, 0.1,
+				 req->timeout_secs, &train_stats,
+				 TRAIN_BATCH( req->batch ) |
+				 ( req->warm_feedback ? TRAIN_WARM_FEEDBACK : 0 ) |
+				 TRAIN_OPTIMIZER( req->optimizer ) |
+				 ( req->json ? TRAIN_TIMINGS : 0 ) ) ) {
+    //train_on_set_r may have allocated the starting weights
+    snprintf( err, errlen, "%s", neural_context_error( ctx ) );
+    free_net_weights( &wght );
+    unload_net( &net );
+    return -1;
+  }
+  if( 0 > test_on_set_r( ctx, &net, sets->test.ptrs, sets->test.count,
+			 &wght, &test_stats, 0 ) ) {
+    snprintf( err, errlen, "%s", neural_context_error( ctx ) );
+    free_net_weights( &wght );
+    unload_net( &net );
+    return -1;
+  }
+  if( req->save_weights &&
+      0 > save_weights( req->save_weights, &net, &wght ) ) {
+    snprintf( err, errlen, "%s", neural_error() );
+    free_net_weights( &wght );
+    unload_net( &net );
+    return -1;
+  }
+
+  if( req->json ) {
+    printf( "ok " );
+    fwrite_statistics_json( stdout, req->net_fname, &net, &train_stats,
+			    &test_stats );
+  } else {
+    print_result( &net.info, &train_stats, &test_stats );
+  }
+  free_net_weights( &wght );
+  unload_net( &net );
+  return 0;
+}
+
+int main( int argc, char *argv[] ) {
+  char line[LINE_MAX_LEN];
+  char err[LINE_MAX_LEN];
+  eval_sets sets;
+  eval_request req;
+  neural_context ctx;
+  float time_limit;
+
+  if( argc < 3 ) {
+    fprintf( stderr, "Usage: %s <training_file> <timelimit>\n", argv[0] );
+    exit( -1 );
+  }
+
+  memset( (void *)&sets, 0, sizeof( eval_sets ) );
+  sets.training_fname = argv[1];
+  sscanf( argv[2], "%f", &time_limit );
+  //one context for the server's lifetime, so scratch space is reused
+  init_neural_context( &ctx, neural_seed() );
+
+  while( fgets( line, LINE_MAX_LEN, stdin ) != NULL ) {
+    req.timeout_secs = (double)time_limit;
+    req.reseed = 0;
+    req.net_name = NULL;
+    req.save_weights = NULL;
+    req.load_weights = NULL;
+    req.batch = 0;
+    req.warm_feedback = 0;
+    req.optimizer = NET_OPTIMIZER_NONE;
+    req.presentation_budget = 0;
+    req.work_budget = 0;
+    req.json = 0;
+    req.replicas = 0;
+    if( 0 > parse_request( line, &req, err, LINE_MAX_LEN ) ||
+	0 > evaluate( &ctx, &sets, &req, err, LINE_MAX_LEN ) ) {
+      //messages from neural_error() may carry their own newline
+      err[strcspn( err, "\r\n" )] = '\0';
+      printf( "error %s\n", err );
+    }
+    //the client blocks on each answer, so don't let stdio hold it
+    fflush( stdout );
+  }
+  free_neural_context( &ctx );
+  return 0;
+}
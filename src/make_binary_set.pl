@@ -0,0 +1,122 @@
+#!/usr/bin/perl -w
+
+#Converts training/test sets to the binary set format libneural loads with
+#load_io_sets() (see neural/include/neural_dataset.h).  The source is
+#either a set file as written by make_train_and_test_set.pl (a project's
+#'training' file), or a .train source like make_train_and_test_set.pl
+#takes.
+
+unless( @ARGV == 2 ) {
+  print "usage: $0 <set file or .train source> <binary_set_output>\n";
+  exit(-1);
+}
+
+my $infile = $ARGV[0];
+my $outfile = $ARGV[1];
+
+my $MAGIC = 'NNST';
+my $VERSION = 1;
+
+open SRC, "<$infile" or die "Can't open $infile: $!";
+my $src;
+{
+  local $/ = undef;
+  $src = <SRC>;
+}
+close SRC;
+
+my( $inlen, $outlen, @sets );
+if( $src =~ /^\s*-?\d/ ) {
+  ( $inlen, $outlen, @sets ) = read_set_file( $src );
+} else {
+  ( $inlen, $outlen, @sets ) = read_train_source( $src );
+}
+
+my $row_bytes = int( ( $inlen + $outlen + 7 ) / 8 );
+my $body = pack( 'i*', map { scalar( @$_ ) } @sets );
+for my $set (@sets) {
+  for my $itm (@$set) {
+    #one bit per value, lowest bit first: set for +1, clear for -1
+    $body .= pack( "b" . ( $row_bytes * 8 ),
+		   join( '', map { $_ > 0 ? 1 : 0 } @$itm ) );
+  }
+}
+
+open OUT, ">$outfile" or die "Can't open $outfile for output: $!";
+binmode OUT;
+print OUT pack( 'a4 i5 I i', $MAGIC, $VERSION, $inlen, $outlen,
+		scalar( @sets ), $row_bytes, fnv1a( $body ), 0 );
+print OUT $body;
+close OUT;
+
+my $total = 0;
+$total += @$_ for @sets;
+print "Wrote ", scalar( @sets ), " sets ($total items) to $outfile\n";
+exit(0);
+
+#32 bit FNV-1a, as in neural/dataset.c
+sub fnv1a {
+  my $hash = 2166136261;
+  for my $byte (unpack( 'C*', shift )) {
+    $hash = ( ( $hash ^ $byte ) * 16777619 ) % 4294967296;
+  }
+  return $hash;
+}
+
+#a count followed by that many items, each written as
+#input count, output count, node count, then the values; repeated per set
+sub read_set_file {
+  my @nums = split( ' ', shift );
+  my( $inlen, $outlen, @sets );
+  while( @nums ) {
+    my $count = shift @nums;
+    my @set;
+    for my $i (1..$count) {
+      my( $in, $out, $nodes ) = splice( @nums, 0, 3 );
+      die "set file ends early\n" unless defined $nodes;
+      $inlen = $in unless defined $inlen;
+      $outlen = $out unless defined $outlen;
+      unless( $in == $inlen and $out == $outlen ) {
+	die "item #$i has $in in/$out out (not $inlen/$outlen)\n";
+      }
+      my @vals = splice( @nums, 0, $in + $out );
+      splice( @nums, 0, $nodes );
+      for my $val (@vals) {
+	die "item #$i has a value other than +1/-1: $val\n"
+	  unless $val == 1 or $val == -1;
+      }
+      push @set, \@vals;
+    }
+    push @sets, \@set;
+  }
+  return $inlen, $outlen, @sets;
+}
+
+#the TRAIN and TEST sets from a .train source; 0s become -1s, as
+#make_train_and_test_set.pl does
+sub read_train_source {
+  my $data = eval shift;
+  if( length( $@ ) ) {
+    die "error in training source: $@";
+  }
+  my( $inlen, $outlen, @sets );
+  for my $key (qw(TRAIN TEST)) {
+    die "Source has no $key set!\n" unless ref( $data->{$key} ) eq 'ARRAY';
+    my @set;
+    for my $itm (@{$data->{$key}}) {
+      my @vals = map { $_ == 0 ? -1 : $_ } ( @{$itm->[0]}, @{$itm->[1]} );
+      for my $val (@vals) {
+	die "$key has a value other than 0/+1/-1: $val\n"
+	  unless $val == 1 or $val == -1;
+      }
+      $inlen = @{$itm->[0]} unless defined $inlen;
+      $outlen = @{$itm->[1]} unless defined $outlen;
+      unless( @{$itm->[0]} == $inlen and @{$itm->[1]} == $outlen ) {
+	die "$key items have different lengths\n";
+      }
+      push @set, \@vals;
+    }
+    push @sets, \@set;
+  }
+  return $inlen, $outlen, @sets;
+}
@@ -0,0 +1,299 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "neural.h"
+
+/* Throughput benchmark for libneural, meant for tracking speed between
+   versions (see bench/Makefile, which runs it as 'make bench').  Each net
+   is given a synthetic set of random +1/-1 examples made from a fixed seed,
+   and timed at:
+
+     load_set      reading the set with load_io_sets() (text format)
+     calc_net      one forward pass (_calc_net)
+     train_net     a forward pass and training on it, applying the changes
+		   (_train_net)
+     train_on_set  train_on_set_r() epochs, with the same seed each time
+
+   all in ns per example.  Every figure is the best of -r repeats, after a
+   warm-up pass, with the process pinned to one CPU; the starting weights
+   come from the seed as well, so only the clock varies between runs.
+
+   usage: neural_bench [-s <seed>] [-n <examples>] [-r <repeats>]
+			[-c <cpu>] [-t <train_secs>] <network> ...
+
+   The results are one line per net and measurement,
+     <net> <measurement> <ns/example>
+   in a fixed order, after a # line giving the settings, so two runs can be
+   compared with diff, or with bench/compare.pl. */
+
+typedef struct _bench_settings_STRUCT {
+  unsigned int seed;
+  int examples;
+  int repeats;
+  int cpu;
+  double train_secs;
+} bench_settings;
+
+double now_ns() {
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+//keeps the timings from moving between CPUs (and their caches)
+int pin_cpu( int cpu ) {
+#ifdef __linux__
+  cpu_set_t set;
+
+  CPU_ZERO( &set );
+  CPU_SET( cpu, &set );
+  return sched_setaffinity( 0, sizeof( cpu_set_t ), &set );
+#else
+  return 0;
+#endif
+}
+
+//count random examples for def
+int synthetic_set( net_definition *def, net_io_set *set, int count,
+		   unsigned int seed ) {
+  int i, j, width = def->info.input_count + def->info.output_count;
+
+  if( 0 > init_io_set( set, count, def, 0 ) ) {
+    return -1;
+  }
+  for( i = 0; i < count; i++ ) {
+    for( j = 0; j < width; j++ ) {
+      //inputs and outputs are adjacent (see init_io_set())
+      set->items[i].inputs[j] = ( rand_r( &seed ) & 1 ) ? 1 : -1;
+    }
+  }
+  return 0;
+}
+
+//writes set as a training set and an empty test set, for load_io_sets()
+int write_set( const char *fname, net_io_set *set ) {
+  FILE *file;
+  int i;
+
+  file = fopen( fname, "w" );
+  if( file == NULL ) {
+    return -1;
+  }
+  fprintf( file, "%d\n", set->count );
+  for( i = 0; i < set->count; i++ ) {
+    if( 0 > fwrite_net_io( file, set->ptrs[i] ) ) {
+      fclose( file );
+      return -1;
+    }
+  }
+  fprintf( file, "0\n" );
+  return fclose( file );
+}
+
+double bench_load( net_definition *def, const char *fname ) {
+  net_io_set sets[2];
+  double start;
+
+  start = now_ns();
+  if( 0 > load_io_sets( fname, sets, 2, def, 0 ) ) {
+    return -1;
+  }
+  start = now_ns() - start;
+  free_io_set( sets );
+  free_io_set( sets + 1 );
+  return start;
+}
+
+double bench_calc( net_definition *def, net_io_set *set, net_io *state,
+		   net_weights *wght ) {
+  double start;
+  int i;
+
+  start = now_ns();
+  for( i = 0; i < set->count; i++ ) {
+    copy_net_io( state, set->ptrs[i], COPY_INPUT );
+    calc_net( def, state, wght );
+  }
+  return now_ns() - start;
+}
+
+double bench_train( net_definition *def, net_io_set *set, net_io *state,
+		    net_weights *wght, net_weights *changes ) {
+  double start;
+  int i;
+
+  start = now_ns();
+  for( i = 0; i < set->count; i++ ) {
+    copy_net_io( state, set->ptrs[i], COPY_INPUT );
+    calc_net( def, state, wght );
+    copy_net_io( state, set->ptrs[i], COPY_OUTPUT );
+    train_net( def, state, wght, changes, 0.1,
+	       NET_CORRECT_OUTPUTS_GIVEN | NET_APPLY_WEIGHT_CHANGES );
+  }
+  return now_ns() - start;
+}
+
+//ns per presentation, over as many epochs as fit in train_secs
+double bench_train_on_set( neural_context *ctx, net_definition *def,
+			   net_io_set *set, bench_settings *s ) {
+  net_weights wght;
+  training_statistics stats;
+
+  ctx->rng_state = s->seed;
+  memset( (void *)&wght, 0, sizeof( net_weights ) );
+  if( 0 > train_on_set_r( ctx, def, set->ptrs, set->count, &wght, 0.1,
+			  s->train_secs, &stats, 0 ) ) {
+    return -1;
+  }
+  free_net_weights( &wght );
+  if( stats.presentation_count == 0 ) {
+    return -1;
+  }
+  return (double)stats.elapsed_seconds * 1e9 / stats.presentation_count;
+}
+
+//the net's file name, without its directory or extension
+void net_label( const char *fname, char *label, size_t len ) {
+  const char *base = strrchr( fname, '/' );
+  char *dot;
+
+  snprintf( label, len, "%s", base ? base + 1 : fname );
+  dot = strrchr( label, '.' );
+  if( dot ) {
+    *dot = '\0';
+  }
+}
+
+void report( const char *label, const char *what, double ns ) {
+  printf( "%-24s %-14s %12.1f\n", label, what, ns );
+}
+
+int bench_net( const char *fname, bench_settings *s, const char *set_fname ) {
+  net_definition def;
+  net_io_set set;
+  net_io state;
+  net_weights wght, changes;
+  neural_context ctx;
+  char label[256];
+  double best[4], t;
+  int r, k;
+
+  if( 0 > load_net( fname, &def ) ) {
+    fprintf( stderr, "%s: %s\n", fname, neural_error() );
+    return -1;
+  }
+  init_neural_context( &ctx, s->seed );
+  if( 0 > synthetic_set( &def, &set, s->examples, s->seed ) ||
+      0 > write_set( set_fname, &set ) ||
+      0 > init_net_io( &def, &state, 1 ) ||
+      0 > init_net_weights( &def, &changes ) ||
+      0 > starting_weights_r( &ctx, &def, &wght ) ) {
+    fprintf( stderr, "%s: can't set up: %s\n", fname, neural_error() );
+    unload_net( &def );
+    return -1;
+  }
+
+  //warm-up
+  bench_calc( &def, &set, &state, &wght );
+  for( k = 0; k < 4; k++ ) {
+    best[k] = -1;
+  }
+  for( r = 0; r < s->repeats; r++ ) {
+    for( k = 0; k < 4; k++ ) {
+      switch( k ) {
+      case 0:
+	t = bench_load( &def, set_fname );
+	break;
+      case 1:
+	t = bench_calc( &def, &set, &state, &wght );
+	break;
+      case 2:
+	t = bench_train( &def, &set, &state, &wght, &changes );
+	break;
+      default:
+	//already per example
+	t = bench_train_on_set( &ctx, &def, &set, s ) * set.count;
+      }
+      if( t >= 0 && ( best[k] < 0 || t < best[k] ) ) {
+	best[k] = t;
+      }
+    }
+  }
+
+  net_label( fname, label, sizeof( label ) );
+  report( label, "load_set", best[0] / set.count );
+  report( label, "calc_net", best[1] / set.count );
+  report( label, "train_net", best[2] / set.count );
+  report( label, "train_on_set", best[3] / set.count );
+
+  free_io_set( &set );
+  free_net_io( &state );
+  free_net_weights( &wght );
+  free_net_weights( &changes );
+  free_neural_context( &ctx );
+  unload_net( &def );
+  return 0;
+}
+
+int main( int argc, char *argv[] ) {
+  bench_settings s;
+  char set_fname[64];
+  int opt, i, failed = 0;
+
+  s.seed = 1;
+  s.examples = 512;
+  s.repeats = 5;
+  s.cpu = 0;
+  s.train_secs = 0.1;
+  while( (opt = getopt( argc, argv, "s:n:r:c:t:" )) != -1 ) {
+    switch( opt ) {
+    case 's':
+      s.seed = (unsigned int)strtoul( optarg, NULL, 10 );
+      break;
+    case 'n':
+      s.examples = atoi( optarg );
+      break;
+    case 'r':
+      s.repeats = atoi( optarg );
+      break;
+    case 'c':
+      s.cpu = atoi( optarg );
+      break;
+    case 't':
+      s.train_secs = atof( optarg );
+      break;
+    default:
+      argc = 0;
+    }
+  }
+  if( argc <= optind || s.examples < 1 || s.repeats < 1 ) {
+    fprintf( stderr, "Usage: %s [-s <seed>] [-n <examples>] [-r <repeats>] [-c <cpu>] [-t <train_secs>] <network> ...\n",
+	     argv[0] );
+    exit( -1 );
+  }
+  if( 0 > pin_cpu( s.cpu ) ) {
+    fprintf( stderr, "%s: can't pin to cpu %d: %s\n", argv[0], s.cpu,
+	     strerror( errno ) );
+  }
+  snprintf( set_fname, sizeof( set_fname ), "/tmp/neural_bench.%d.set",
+	    (int)getpid() );
+
+  printf( "# neural_bench seed=%u examples=%d repeats=%d cpu=%d train_secs=%g"
+	  " (ns/example)\n", s.seed, s.examples, s.repeats, s.cpu,
+	  s.train_secs );
+  for( i = optind; i < argc; i++ ) {
+    if( 0 > bench_net( argv[i], &s, set_fname ) ) {
+      failed = 1;
+    }
+    //a line at a time, for watching a long run
+    fflush( stdout );
+  }
+  unlink( set_fname );
+  return failed ? 1 : 0;
+}
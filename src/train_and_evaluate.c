@@ -1,8 +1,10 @@
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "neural.h"
 
@@ -13,25 +15,152 @@ void printdbls( double *dbls, int count ) {
   }
 }
 
+/* trains count replicas, printing a line for each (unless json), and
+   leaves the one which does best on the test set in wght, with its test
+   statistics in test; stats gets the replicas' aggregate */
+int train_best_replica( char *prog, neural_context *ctx, net_definition *net,
+			net_io_set *sets, net_weights *wght, int count,
+			double time_limit, int flags, int json,
+			training_statistics *stats, test_statistics *test ) {
+  net_replicas reps;
+  training_statistics *per;
+  test_statistics cur;
+  int r, best = -1;
+
+  memset( (void *)wght, 0, sizeof( net_weights ) );
+  per = (training_statistics *)calloc( count, sizeof( training_statistics ) );
+  if( !per ) {
+    fprintf( stderr, "%s: can't allocate statistics for %d replicas\n",
+	     prog, count );
+    return -1;
+  }
+  if( 0 > init_net_replicas( net, &reps, count ) ) {
+    fprintf( stderr, "%s: %s\n", prog, neural_error() );
+    free( per );
+    return -1;
+  }
+  if( 0 > train_replicas_r( ctx, net, sets[0].ptrs, sets[0].count, &reps,
+			    0.1, time_limit, per, stats, flags ) ) {
+    fprintf( stderr, "%s: can't train replicas: %s\n", prog,
+	     neural_context_error( ctx ) );
+    free_net_replicas( &reps );
+    free( per );
+    return -1;
+  }
+  for( r = 0; r < count; r++ ) {
+    if( 0 > get_replica_weights( net, &reps, r, wght ) ) {
+      fprintf( stderr, "%s: %s\n", prog, neural_error() );
+      free_net_replicas( &reps );
+      free( per );
+      return -1;
+    }
+    test_on_set( net, sets[1].ptrs, sets[1].count, wght, &cur, 0 );
+    if( !json ) {
+      printf( "replica %d: iterations %d, learned %d, elapsed %f, "
+	      "successful_items %d\n", r, per[r].iteration_count,
+	      per[r].learned_count, per[r].elapsed_seconds,
+	      cur.successful_items );
+    }
+    if( best < 0 || cur.successful_items > test->successful_items ||
+	( cur.successful_items == test->successful_items &&
+	  cur.partial_success_avg > test->partial_success_avg ) ) {
+      best = r;
+      *test = cur;
+    }
+  }
+  get_replica_weights( net, &reps, best, wght );
+  free_net_replicas( &reps );
+  free( per );
+  return 0;
+}
+
 int main( int argc, char *argv[] ) {
   net_definition net;
-  net_io **training_set, **test_set;
-  net_io *training_buf, *test_buf;
+  net_io_set sets[2];
   net_weights wght;
-  int training_set_size, test_set_size;
   float time_limit;
-  FILE *trainf;
   //usage: t_a_e network_lib.so training_file weights_output [weights_input]
   // (weights_input is for later)
-  char *net_fname, *training_fname, *wghts;
+  char *net_fname, *training_fname, *test_fname = NULL, *wghts;
   training_statistics train_stats;
   test_statistics test_stats;
+  neural_context ctx;
+  //-t <threads> trains with train_on_set_parallel_r, -H makes that
+  //Hogwild, -b <n> trains in mini-batches of n, -w warm-starts feedback,
+  //-j prints the statistics (with timings) as a line of JSON,
+  //-k <replicas> trains that many replicas with train_replicas_r, and
+  //keeps the best, -o <optimizer> trains with momentum, rprop or
+  //adaptive (see TRAIN_OPTIMIZER), -s <seed> repeats a run exactly, and
+  //-p <presentations> and -W <work> stop training on a budget (see
+  //neural_context) rather than only on the time limit, -T <test_file>
+  //tests on the first set in test_file rather than the training file's
+  //second, and -S <chunk> (which needs -T) streams the training set from
+  //the file in chunks of that many examples (see net_stream) rather than
+  //loading it
+  int opt, threads = 1, flags = 0, batch = 0, json = 0, replicas = 0, i;
+  int chunk = 0;
+  net_stream *stream = NULL;
+  int optimizer = NET_OPTIMIZER_NONE, seeded = 0;
+  unsigned int seed = 0;
+  long presentation_budget = 0;
+  double work_budget = 0;
 
-  if( argc < 4 ) {
-    fprintf( stderr, "Usage: %s <network> <training_file> <timelimit> [<output_weights>]\n",
+  while( (opt = getopt( argc, argv, "t:Hb:wjk:o:s:p:W:S:T:" )) != -1 ) {
+    switch( opt ) {
+    case 't':
+      threads = atoi( optarg );
+      break;
+    case 'H':
+      flags |= TRAIN_HOGWILD;
+      break;
+    case 'b':
+      batch = atoi( optarg );
+      break;
+    case 'w':
+      flags |= TRAIN_WARM_FEEDBACK;
+      break;
+    case 'j':
+      json = 1;
+      flags |= TRAIN_TIMINGS;
+      break;
+    case 'k':
+      replicas = atoi( optarg );
+      break;
+    case 'o':
+      optimizer = net_optimizer_kind( optarg );
+      break;
+    case 's':
+      seed = (unsigned int)strtoul( optarg, NULL, 10 );
+      seeded = 1;
+      break;
+    case 'p':
+      presentation_budget = atol( optarg );
+      break;
+    case 'W':
+      work_budget = atof( optarg );
+      break;
+    case 'S':
+      chunk = atoi( optarg );
+      break;
+    case 'T':
+      test_fname = optarg;
+      break;
+    default:
+      argc = 0;
+    }
+  }
+  //drop the options, keeping the program name in argv[0]
+  argv[optind - 1] = argv[0];
+  argc -= optind - 1;
+  argv += optind - 1;
+  if( argc < 4 || batch < 0 || replicas < 0 || optimizer < 0 ||
+      presentation_budget < 0 || work_budget < 0 || chunk < 0 ||
+      ( chunk && ( threads > 1 || replicas || !test_fname ) ) ) {
+    fprintf( stderr, "Usage: %s [-t <threads> [-H]] [-b <batch>] [-w] [-j] [-k <replicas>] [-o none|momentum|rprop|adaptive] [-s <seed>] [-p <presentations>] [-W <work>] [-T <test_file> [-S <chunk>]] <network> <training_file> <timelimit> [<output_weights>]\n",
 	     argv[0] );
     exit( -1 );
   }
+  flags |= TRAIN_BATCH( batch ) | TRAIN_OPTIMIZER( optimizer );
 
   net_fname = argv[1];
   training_fname = argv[2];
@@ -44,56 +173,92 @@ int main( int argc, char *argv[] ) {
     exit( -1 );
   }
 
-  trainf = fopen( training_fname, "r" );
-  if( trainf == NULL ) {
-    fprintf( stderr, "%s: can't open training file %s: %s\n",
-	    argv[0], training_fname, strerror( errno ) );
-    exit( -1 );
-  }
-
-  if( 0 > fread_net_io_set( trainf, &training_buf, &training_set, 
-			    &training_set_size, &net, 0 ) ) {
-    fprintf( stderr, "%s: can't load training set: %s\n",
-	     argv[0], neural_error() );
-    exit( -1 );
-  }
-  
-  if( 0 > fread_net_io_set( trainf, &test_buf, &test_set,
-			    &test_set_size, &net, 0 ) ) {
-    fprintf( stderr, "%s: can't load test set: %s\n",
+  //text or binary (make_binary_set.pl) sets; training, then test
+  if( test_fname ) {
+    //a streamed training set is read as it trains, so only the test set
+    //is loaded, and its own file spares reading the training set past it
+    if( 0 > ( chunk ?
+	      open_net_stream( training_fname, &net, chunk, &stream ) :
+	      load_io_set( training_fname, 0, &sets[0], &net, 0 ) ) ||
+	0 > load_io_set( test_fname, 0, &sets[1], &net, 0 ) ) {
+      fprintf( stderr, "%s: can't load training/test sets: %s\n",
+	       argv[0], neural_error() );
+      exit( -1 );
+    }
+  } else if( 0 > load_io_sets( training_fname, sets, 2, &net, 0 ) ) {
+    fprintf( stderr, "%s: can't load training/test sets: %s\n",
 	     argv[0], neural_error() );
     exit( -1 );
   }
 
   //almost ready for training
 
-  starting_weights( &net, &wght );
+  init_neural_context( &ctx, seeded ? seed : neural_seed() );
+  ctx.presentation_budget = presentation_budget;
+  ctx.work_budget = work_budget;
+  if( replicas ) {
+    if( 0 > train_best_replica( argv[0], &ctx, &net, sets, &wght, replicas,
+				(double)time_limit, flags, json,
+				&train_stats, &test_stats ) ) {
+      exit( -1 );
+    }
+  } else {
+    if( 0 > ( stream ?
+	      train_on_stream_r( &ctx, &net, stream, &wght, 0.1,
+				 (double)time_limit, &train_stats, flags ) :
+	      train_on_set_parallel_r( &ctx, &net, sets[0].ptrs,
+				       sets[0].count, &wght, 0.1,
+				       (double)time_limit, &train_stats,
+				       flags, threads ) ) ) {
+      fprintf( stderr, "%s: can't train: %s\n", argv[0],
+	       neural_context_error( &ctx ) );
+      exit( -1 );
+    }
+    if( stream ) {
+      close_net_stream( stream );
+    }
+    test_on_set_r( &ctx, &net, sets[1].ptrs, sets[1].count, &wght,
+		   &test_stats, 0 );
+  }
 
-  train_on_set( &net, training_set, training_set_size,
-		&wght, 0.1, (double)time_limit, &train_stats, 0 );
+  if( json ) {
+    fwrite_statistics_json( stdout, net_fname, &net, &train_stats, &test_stats );
+  } else {
+    printf( "=====...=====\n" );
 
-  test_on_set( &net, test_set, test_set_size, &wght, &test_stats, 0 );
+    printf( "training_statistics::\n" );
 
-  printf( "=====...=====\n" );
+    printf( "iteration_count: %d\n", train_stats.iteration_count );
+    printf( "presentation_count: %d\n", train_stats.presentation_count );
+    printf( "training_count: %d\n", train_stats.training_count );
+    printf( "correct_count: %d\n", train_stats.correct_count );
+    printf( "learned_count: %d\n", train_stats.learned_count );
+    printf( "elapsed_seconds: %f\n", train_stats.elapsed_seconds );
+    printf( "correct_rate: %f\n", train_stats.correct_rate );
+    printf( "learned_fraction: %f\n", train_stats.learned_fraction );
+    printf( "update_count: %d\n", train_stats.update_count );
+    printf( "work: %.0f\n", train_stats.work );
+    //sweeps per feedback group, forward and backward
+    for( i = 0; i < net.info.feedback_groups && i < NET_FEEDBACK_STATS; i++ ) {
+      printf( "feedback_group_%d_sweeps: %ld %ld\n", i,
+	      train_stats.feedback.sweeps[i], train_stats.feedback.error_sweeps[i] );
+    }
+    if( net.info.feedback_groups ) {
+      printf( "feedback_unsettled: %ld\n", train_stats.feedback.unsettled );
+    }
+    printf( "...\n" );
 
-  printf( "training_statistics::\n" );
+    printf( "test_statistics::\n" );
 
-  printf( "iteration_count: %d\n", train_stats.iteration_count );
-  printf( "presentation_count: %d\n", train_stats.presentation_count );
-  printf( "training_count: %d\n", train_stats.training_count );
-  printf( "correct_count: %d\n", train_stats.correct_count );
-  printf( "learned_count: %d\n", train_stats.learned_count );
-  printf( "elapsed_seconds: %f\n", train_stats.elapsed_seconds );
-  printf( "correct_rate: %f\n", train_stats.correct_rate );
-  printf( "learned_fraction: %f\n", train_stats.learned_fraction );
-  printf( "...\n" );
-  
-  printf( "test_statistics::\n" );
+    printf( "successful_items: %d\n", test_stats.successful_items );
+    printf( "success_rate: %f\n", test_stats.success_rate );
+    printf( "partial_success_avg: %f\n", test_stats.partial_success_avg );
+    printf( "...\n" );
+  }
 
-  printf( "successful_items: %d\n", test_stats.successful_items );
-  printf( "success_rate: %f\n", test_stats.success_rate );
-  printf( "partial_success_avg: %f\n", test_stats.partial_success_avg );
-  printf( "...\n" );
-  
+  if( argc > 4 && 0 > save_weights( argv[4], &net, &wght ) ) {
+    fprintf( stderr, "%s: can't save weights: %s\n", argv[0], neural_error() );
+    exit( -1 );
+  }
 }
   
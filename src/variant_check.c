@@ -0,0 +1,200 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "neural.h"
+
+/* Checks that a faster variant of a net (compiled with NetCompiler's
+   precision => 'float' and/or activation => 'fast' options) learns the
+   same way as the exact net.  Both start from the same weights and are
+   trained for the given number of passes over the training set, in the
+   same order; the error of the variant's node values, the fraction
+   correct on each pass, the test set results and the time taken are
+   reported for each.
+
+   usage: variant_check <exact.so> <variant.so> <training_file> <passes>
+
+   Exits with status 1 if the variant learned differently: more than
+   MAX_RATE_DIFF apart in the fraction of presentations it got right
+   while training, or in its success rate on the test set. */
+
+#define MAX_RATE_DIFF 0.05
+
+typedef struct _variant_STRUCT {
+  const char *fname;
+  net_definition net;
+  net_weights wght;
+  net_weights changes;
+  net_io state;
+  int correct_count;
+  double train_secs;
+  test_statistics test;
+} variant;
+
+double seconds_since( struct timeval *start ) {
+  struct timeval now;
+  gettimeofday( &now, NULL );
+  return (double)( now.tv_sec - start->tv_sec ) +
+    (double)( now.tv_usec - start->tv_usec ) / 1000000;
+}
+
+const char *variant_name( struct net_info *info ) {
+  switch( info->variant & ( NET_VARIANT_FLOAT | NET_VARIANT_FAST_SIGMOID ) ) {
+  case 0:
+    return "double, exact sigmoid";
+  case NET_VARIANT_FLOAT:
+    return "float, exact sigmoid";
+  case NET_VARIANT_FAST_SIGMOID:
+    return "double, fast sigmoid";
+  default:
+    return "float, fast sigmoid";
+  }
+}
+
+int setup_variant( variant *v ) {
+  if( 0 > load_net( v->fname, &v->net ) ||
+      0 > init_net_weights( &v->net, &v->wght ) ||
+      0 > init_net_weights( &v->net, &v->changes ) ||
+      0 > init_net_io( &v->net, &v->state, 1 ) ) {
+    return -1;
+  }
+  return 0;
+}
+
+//largest difference between the two nets' node values over the set
+double node_error( variant *a, variant *b, net_io **set, int set_size ) {
+  int i, j;
+  double diff, max = 0;
+
+  for( i = 0; i < set_size; i++ ) {
+    copy_net_io( &a->state, set[i], COPY_INPUT );
+    copy_net_io( &b->state, set[i], COPY_INPUT );
+    calc_net( &a->net, &a->state, &a->wght );
+    calc_net( &b->net, &b->state, &b->wght );
+    for( j = 0; j < a->state.node_count; j++ ) {
+      diff = fabs( a->state.node_values[j] - b->state.node_values[j] );
+      if( diff > max ) {
+	max = diff;
+      }
+    }
+  }
+  return max;
+}
+
+//trains on the examples which come out wrong, as train_on_set() does;
+//returns the number which came out right
+int train_pass( variant *v, net_io **set, int set_size ) {
+  int i, correct = 0;
+  struct timeval start;
+
+  gettimeofday( &start, NULL );
+  for( i = 0; i < set_size; i++ ) {
+    copy_net_io( &v->state, set[i], COPY_INPUT );
+    calc_net( &v->net, &v->state, &v->wght );
+    if( 0 < test_io_output( &v->state, set[i] ) ) {
+      correct++;
+      continue;
+    }
+    copy_net_io( &v->state, set[i], COPY_OUTPUT );
+    train_net( &v->net, &v->state, &v->wght, &v->changes, 0.1,
+	       NET_CORRECT_OUTPUTS_GIVEN | NET_APPLY_WEIGHT_CHANGES );
+  }
+  v->train_secs += seconds_since( &start );
+  v->correct_count += correct;
+  return correct;
+}
+
+int main( int argc, char *argv[] ) {
+  variant exact, fast;
+  net_io **training_set, **test_set;
+  net_io *training_buf, *test_buf;
+  int training_set_size, test_set_size;
+  int passes, p, differs;
+  double train_diff;
+  neural_context ctx;
+  FILE *trainf;
+
+  if( argc < 5 ) {
+    fprintf( stderr, "Usage: %s <exact.so> <variant.so> <training_file> <passes>\n",
+	     argv[0] );
+    exit( -1 );
+  }
+  memset( (void *)&exact, 0, sizeof( variant ) );
+  memset( (void *)&fast, 0, sizeof( variant ) );
+  exact.fname = argv[1];
+  fast.fname = argv[2];
+  passes = atoi( argv[4] );
+
+  if( 0 > setup_variant( &exact ) || 0 > setup_variant( &fast ) ) {
+    fprintf( stderr, "%s: can't initialize neural network: %s\n",
+	     argv[0], neural_error() );
+    exit( -1 );
+  }
+  if( exact.net.info.input_count != fast.net.info.input_count ||
+      exact.net.info.output_count != fast.net.info.output_count ||
+      exact.net.info.weight_count != fast.net.info.weight_count ||
+      exact.net.info.node_count != fast.net.info.node_count ) {
+    fprintf( stderr, "%s: the two nets have different shapes\n", argv[0] );
+    exit( -1 );
+  }
+
+  trainf = fopen( argv[3], "r" );
+  if( trainf == NULL ) {
+    fprintf( stderr, "%s: can't open training file %s: %s\n",
+	     argv[0], argv[3], strerror( errno ) );
+    exit( -1 );
+  }
+  if( 0 > fread_net_io_set( trainf, &training_buf, &training_set,
+			    &training_set_size, &exact.net, 0 ) ||
+      0 > fread_net_io_set( trainf, &test_buf, &test_set,
+			    &test_set_size, &exact.net, 0 ) ) {
+    fprintf( stderr, "%s: can't load training and test sets: %s\n",
+	     argv[0], neural_error() );
+    exit( -1 );
+  }
+  fclose( trainf );
+
+  //same starting weights for both
+  init_neural_context( &ctx, 1 );
+  if( 0 > starting_weights_r( &ctx, &exact.net, &exact.wght ) ) {
+    fprintf( stderr, "%s: %s\n", argv[0], neural_context_error( &ctx ) );
+    exit( -1 );
+  }
+  free_neural_context( &ctx );
+  memcpy( fast.wght.weights, exact.wght.weights,
+	  sizeof( double ) * exact.wght.weight_count );
+
+  printf( "exact: %s\nvariant: %s\n", variant_name( &exact.net.info ),
+	  variant_name( &fast.net.info ) );
+  printf( "max node value error: %g\n",
+	  node_error( &exact, &fast, training_set, training_set_size ) );
+
+  for( p = 0; p < passes; p++ ) {
+    printf( "pass %d: exact %d, variant %d of %d correct\n", p + 1,
+	    train_pass( &exact, training_set, training_set_size ),
+	    train_pass( &fast, training_set, training_set_size ),
+	    training_set_size );
+  }
+  test_on_set( &exact.net, test_set, test_set_size, &exact.wght,
+	       &exact.test, 0 );
+  test_on_set( &fast.net, test_set, test_set_size, &fast.wght,
+	       &fast.test, 0 );
+
+  printf( "training: exact %.1f us/example, variant %.1f us/example\n",
+	  exact.train_secs * 1e6 / ( (double)training_set_size * passes ),
+	  fast.train_secs * 1e6 / ( (double)training_set_size * passes ) );
+  printf( "test success rate: exact %f, variant %f\n",
+	  exact.test.success_rate, fast.test.success_rate );
+
+  train_diff = (double)( exact.correct_count - fast.correct_count ) /
+    ( (double)training_set_size * passes );
+  differs = fabs( train_diff ) > MAX_RATE_DIFF ||
+    fabs( exact.test.success_rate - fast.test.success_rate ) > MAX_RATE_DIFF;
+  printf( "%s\n", differs ? "LEARNING DIFFERS" : "learning unchanged" );
+  unload_net( &exact.net );
+  unload_net( &fast.net );
+  return differs ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+#!/usr/bin/perl -w
+use strict;
+
+#trains replicas on a work budget small enough that some of them stop on
+#it before learning the set while others still run, and checks that those
+#don't come back as having learned it.  Run from the top directory, after
+#make, e.g.: test/replica_budget.pl networks/binary_counter.so bc.set
+
+my( $net, $set, $budget ) = @ARGV;
+die "usage: $0 <network.so> <set_file> [<work_budget>]\n"
+  unless defined $set;
+$budget = 600000 unless defined $budget;
+
+my @out = `src/train_and_evaluate -s 5 -k 8 -W $budget $net $set 5`;
+die "train_and_evaluate failed\n" if $?;
+
+my( @learned, $fraction );
+for( @out ) {
+  if( /^replica \d+: iterations \d+, learned (\d+)/ ) {
+    push @learned, $1;
+  } elsif( /^learned_fraction: (\S+)/ ) {
+    $fraction = $1;
+  }
+}
+die "no replica lines\n" unless @learned and defined $fraction;
+my( $min, $max ) = ( sort { $a <=> $b } @learned )[0, -1];
+print "learned: @learned; learned_fraction: $fraction\n";
+#the best replicas learned the set, so the rest stopped on the budget
+if( $min < $max and $fraction < 1 ) {
+  print "ok\n";
+} else {
+  print "FAILED: budget-stopped replicas should report what they learned\n";
+  exit 1;
+}